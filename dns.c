@@ -0,0 +1,2602 @@
+#define _GNU_SOURCE
+#include <complex.h>
+#include <fcntl.h>
+#include <fftw3.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "dns.h"
+#include "util.h"
+
+enum { pool_spin = 1 << 14, pool_yield = 1 << 20 };
+static const double pi = 3.141592653589793238;
+static const double a[] = {1 / 6.0, 1 / 3.0, 1 / 3.0, 1 / 6.0};
+static const double b[] = {0.5, 0.5, 1.0};
+
+/* Persistent thread team. Workers spin on the generation counter for
+   pool_spin iterations and then sleep on the condition variable; the
+   calling thread is member 0 and waits for the others on the busy
+   counter. Every dispatch splits [0, n) into the same static chunks so
+   a thread touches the same slab in the FFT and pointwise phases. A
+   dispatch can be limited to the first team members; the others wake
+   up and return. mask is the CPU set of the process, which pool_pin
+   narrows to one CPU per member or restores. A dispatch from inside a
+   dispatch, as FFTW makes when it gives the spare threads of a short
+   vector loop to child plans, runs serially in the calling member:
+   member is set in the workers and in member 0 while it runs its
+   chunk. */
+static struct {
+  int nthreads, team;
+  cpu_set_t mask;
+  pthread_t *threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  unsigned long generation;
+  int busy;
+  void (*work)(void *, long, long, int);
+  void *arg;
+  long n;
+} pool;
+static __thread int member;
+static void pool_pause(void) {
+#ifdef __x86_64__
+  __builtin_ia32_pause();
+#endif
+}
+static void pool_relax(long spin) {
+  if (spin < pool_yield)
+    pool_pause();
+  else
+    sched_yield();
+}
+static void pool_run(int id) {
+  long lo, hi;
+  lo = pool.n * id / pool.team;
+  hi = pool.n * (id + 1) / pool.team;
+  if (id < pool.team && lo < hi)
+    pool.work(pool.arg, lo, hi, id);
+}
+static void *pool_worker(void *p) {
+  int id;
+  long spin;
+  unsigned long seen, gen;
+  id = (int)(intptr_t)p;
+  member = 1;
+  seen = 0;
+  for (;;) {
+    for (spin = 0; spin < pool_spin; spin++) {
+      if ((gen = __atomic_load_n(&pool.generation, __ATOMIC_ACQUIRE)) != seen)
+        break;
+      pool_pause();
+    }
+    if (gen == seen) {
+      pthread_mutex_lock(&pool.mutex);
+      while ((gen = __atomic_load_n(&pool.generation, __ATOMIC_ACQUIRE)) ==
+             seen)
+        pthread_cond_wait(&pool.cond, &pool.mutex);
+      pthread_mutex_unlock(&pool.mutex);
+    }
+    seen = gen;
+    if (pool.work == NULL)
+      return NULL;
+    pool_run(id);
+    __atomic_sub_fetch(&pool.busy, 1, __ATOMIC_ACQ_REL);
+  }
+}
+static void pool_for(long n, void (*work)(void *, long, long, int),
+                     void *arg) {
+  long spin;
+  if (pool.team == 1 || member) {
+    if (n > 0)
+      work(arg, 0, n, 0);
+    return;
+  }
+  pool.work = work;
+  pool.arg = arg;
+  pool.n = n;
+  __atomic_store_n(&pool.busy, pool.nthreads - 1, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&pool.mutex);
+  __atomic_add_fetch(&pool.generation, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool.cond);
+  pthread_mutex_unlock(&pool.mutex);
+  member = 1;
+  pool_run(0);
+  member = 0;
+  for (spin = 0; __atomic_load_n(&pool.busy, __ATOMIC_ACQUIRE) != 0; spin++)
+    pool_relax(spin);
+}
+static void pool_fini(void);
+/* On failure the members already started are stopped again */
+static int pool_init(int nthreads) {
+  int id;
+  pool.nthreads = pool.team = nthreads;
+  pool.threads = malloc(nthreads * sizeof *pool.threads);
+  sched_getaffinity(0, sizeof pool.mask, &pool.mask);
+  pthread_mutex_init(&pool.mutex, NULL);
+  pthread_cond_init(&pool.cond, NULL);
+  for (id = 1; id < nthreads; id++)
+    if (pthread_create(&pool.threads[id], NULL, pool_worker,
+                       (void *)(intptr_t)id) != 0) {
+      fprintf(stderr, "dns: error: pthread_create failed\n");
+      pool.nthreads = pool.team = id;
+      pool_fini();
+      return -1;
+    }
+  return 0;
+}
+/* Pin member id to the id-th CPU of the process, or unpin it */
+static void pool_pin(int pin) {
+  cpu_set_t set;
+  int id, cpu, c;
+  for (id = 0; id < pool.nthreads; id++) {
+    set = pool.mask;
+    if (pin) {
+      for (cpu = 0, c = id % CPU_COUNT(&pool.mask);; cpu++)
+        if (CPU_ISSET(cpu, &pool.mask) && c-- == 0)
+          break;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(id == 0 ? pthread_self() : pool.threads[id],
+                           sizeof set, &set);
+  }
+}
+static void pool_fini(void) {
+  int id;
+  pool_pin(0);
+  pool.work = NULL;
+  pthread_mutex_lock(&pool.mutex);
+  __atomic_add_fetch(&pool.generation, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool.cond);
+  pthread_mutex_unlock(&pool.mutex);
+  for (id = 1; id < pool.nthreads; id++)
+    pthread_join(pool.threads[id], NULL);
+  pthread_mutex_destroy(&pool.mutex);
+  pthread_cond_destroy(&pool.cond);
+  free(pool.threads);
+  pool.generation = 0;
+}
+struct jobs {
+  void *(*work)(char *);
+  char *jobdata;
+  size_t elsize;
+};
+static void k_jobs(void *arg, long lo, long hi, int id) {
+  struct jobs *j;
+  (void)id;
+  j = arg;
+  for (; lo < hi; lo++)
+    j->work(j->jobdata + j->elsize * lo);
+}
+static void parallel_loop(void *(*work)(char *), char *jobdata, size_t elsize,
+                          int njobs, void *data) {
+  struct jobs j;
+  (void)data;
+  j.work = work;
+  j.jobdata = jobdata;
+  j.elsize = elsize;
+  pool_for(njobs, k_jobs, &j);
+}
+
+/* Fields shared by the kernels below. The grid has nx * ny * nz points
+   on [0, Lx) x [0, Ly) x [0, Lz) with z the fastest index. The spectral
+   kernels run over the nx * ny rows of nf = nz / 2 + 1 complex modes, the
+   physical ones over the nx * ny rows of nz points stored ld apart (nz,
+   or 2 * nf for in-place transforms). Components of a vector field are s
+   apart: s = 1 for separate arrays, s = 3 for the interleaved layout
+   where V = U + 1 and W = U + 2. kk and the dealiasing mask are
+   recomputed from kx, ky, kz and the cut-offs kxmax, kymax, kzmax. The
+   rest is the state of the run behind the interface of dns.h: fresh
+   is set while U, V, W hold the current velocity. history tells what
+   U_hat0 holds for the multistep scheme: nothing (0), the velocity of
+   the previous step (1) or its nonlinear term (2). fd is the file of
+   the out-of-core arena, or -1. team is the number of threads of each
+   phase of the step and fft that of the plans (dns_param.tune). status
+   is the published record (dns_param.status) and clock the time spent
+   in the FFTs and the phases since the step since_step at since. */
+enum {
+  phase_copy,
+  phase_curl,
+  phase_cross,
+  phase_project,
+  phase_update,
+  phase_n
+};
+struct dns {
+  long nx, ny, nz, nf, ld, s, gs;
+  double Lx, Ly, Lz, invN, nu, dt, coef;
+  double *kx, *ky, *kz, *kz2, *mask2, kxmax, kymax, kzmax;
+  double *U, *V, *W, *CU, *CV, *CW, *U_tmp, *V_tmp, *W_tmp, *dump, *real;
+  fftw_complex *U_hat, *V_hat, *W_hat, *U_hat0, *V_hat0, *W_hat0, *U_hat1,
+      *V_hat1, *W_hat1, *dU, *dV, *dW, *curlX, *curlY, *curlZ, *P_hat, *src,
+      *dst, *dump_hat;
+  long double *energy, *Omega;
+  double *stats;
+  fftw_plan fplan, bplan, dplan, xplan[4];
+  const struct kernels *kern;
+  struct insitu *q;
+  struct tracers *tr;
+  int min, fresh, nthreads, nq, ab2, history, verbose, fd, behind;
+  int team[phase_n], fft, pin;
+  struct dns_status *status;
+  char *status_path;
+  double clock[dns_status_ntime], since;
+  long since_step;
+  char *arena;
+  size_t arena_size, arena_used, arena_map;
+  long block, tstep;
+  double t;
+};
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+static void phase_for(struct dns *d, int phase, long n,
+                      void (*work)(void *, long, long, int), void *arg) {
+  double t;
+  t = d->status != NULL ? now() : 0;
+  pool.team = d->team[phase];
+  pool_for(n, work, arg);
+  pool.team = pool.nthreads;
+  if (d->status != NULL)
+    d->clock[1 + phase] += now() - t;
+}
+static double cabs2(fftw_complex z) {
+  return creal(z) * creal(z) + cimag(z) * cimag(z);
+}
+static void k_energy(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long i, j, k, l, m, ny, nf;
+  long double energy, Omega;
+  double *kx, *ky, *kz, kk;
+  d = arg;
+  ny = d->ny;
+  nf = d->nf;
+  kx = d->kx;
+  ky = d->ky;
+  kz = d->kz;
+  energy = 0.0;
+  Omega = 0.0;
+  for (; lo < hi; lo++) {
+    i = lo / ny;
+    j = lo % ny;
+    for (k = 0; k < nf; k++) {
+      l = lo * nf + k;
+      m = l * d->s;
+      kk = kx[i] * kx[i] + ky[j] * ky[j] + kz[k] * kz[k];
+      energy += cabs2(d->U_hat[m]) + cabs2(d->V_hat[m]) + cabs2(d->W_hat[m]);
+      Omega +=
+          kk * (cabs2(d->U_hat[m]) + cabs2(d->V_hat[m]) + cabs2(d->W_hat[m]));
+    }
+  }
+  d->energy[id] = energy;
+  d->Omega[id] = Omega;
+}
+static void k_copy(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  (void)id;
+  d = arg;
+  memcpy(d->dst + lo * d->nf * d->s, d->src + lo * d->nf * d->s,
+         (hi - lo) * d->nf * d->s * sizeof(fftw_complex));
+}
+static void k_gather(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k;
+  (void)id;
+  d = arg;
+  for (k = lo * d->nf; k < hi * d->nf; k++)
+    d->dst[k] = d->src[k * d->gs];
+}
+static void k_scale(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k;
+  double *real;
+  (void)id;
+  d = arg;
+  for (; lo < hi; lo++) {
+    real = d->real + lo * d->ld * d->gs;
+    for (k = 0; k < d->nz; k++)
+      real[k * d->gs] *= d->invN;
+  }
+}
+static void k_start(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, m;
+  (void)id;
+  d = arg;
+  for (k = lo * d->nf; k < hi * d->nf; k++) {
+    m = k * d->s;
+    d->U_hat0[m] = d->U_hat[m];
+    d->V_hat0[m] = d->V_hat[m];
+    d->W_hat0[m] = d->W_hat[m];
+    d->U_hat1[m] = d->U_hat[m];
+    d->V_hat1[m] = d->V_hat[m];
+    d->W_hat1[m] = d->W_hat[m];
+  }
+}
+static void curl_row(struct dns *d, long row, long k) {
+  long i, j, l, m;
+  double *kx, *ky, *kz;
+  kx = d->kx;
+  ky = d->ky;
+  kz = d->kz;
+  i = row / d->ny;
+  j = row % d->ny;
+  for (; k < d->nf; k++) {
+    l = row * d->nf + k;
+    m = l * d->s;
+    d->curlZ[m] = I * (kx[i] * d->V_hat[m] - ky[j] * d->U_hat[m]);
+    d->curlY[m] = I * (kz[k] * d->U_hat[m] - kx[i] * d->W_hat[m]);
+    d->curlX[m] = I * (ky[j] * d->W_hat[m] - kz[k] * d->V_hat[m]);
+  }
+}
+static void k_curl(void *arg, long lo, long hi, int id) {
+  (void)id;
+  for (; lo < hi; lo++)
+    curl_row(arg, lo, 0);
+}
+static void k_cross(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long l, m, e;
+  double u, v, w, cu, cv, cw;
+  (void)id;
+  d = arg;
+  for (; lo < hi; lo++)
+    for (l = lo * d->ld, e = l + d->nz; l < e; l++) {
+      m = l * d->s;
+      u = d->U[m] *= d->invN;
+      v = d->V[m] *= d->invN;
+      w = d->W[m] *= d->invN;
+      cu = d->CU[m] * d->invN;
+      cv = d->CV[m] * d->invN;
+      cw = d->CW[m] * d->invN;
+      d->U_tmp[m] = v * cw - w * cv;
+      d->V_tmp[m] = w * cu - u * cw;
+      d->W_tmp[m] = u * cv - v * cu;
+    }
+}
+static void project_row(struct dns *d, long row, long k) {
+  long i, j, l, m;
+  double *kx, *ky, *kz, kk, nu, dt, mask;
+  int dealias;
+  fftw_complex P;
+  kx = d->kx;
+  ky = d->ky;
+  kz = d->kz;
+  nu = d->nu;
+  dt = d->dt;
+  i = row / d->ny;
+  j = row % d->ny;
+  dealias = (fabs(kx[i]) < d->kxmax) && (fabs(ky[j]) < d->kymax);
+  for (; k < d->nf; k++) {
+    l = row * d->nf + k;
+    m = l * d->s;
+    kk = kx[i] * kx[i] + ky[j] * ky[j] + kz[k] * kz[k];
+    mask = (dealias && (fabs(kz[k]) < d->kzmax)) * dt;
+    d->dU[m] *= mask;
+    d->dV[m] *= mask;
+    d->dW[m] *= mask;
+    P = kk > 0 ? (d->dU[m] * kx[i] + d->dV[m] * ky[j] + d->dW[m] * kz[k]) / kk
+               : 0.0;
+    d->dU[m] -= P * kx[i] + nu * dt * kk * d->U_hat[m];
+    d->dV[m] -= P * ky[j] + nu * dt * kk * d->V_hat[m];
+    d->dW[m] -= P * kz[k] + nu * dt * kk * d->W_hat[m];
+    if (d->P_hat != NULL)
+      d->P_hat[l] = P;
+  }
+}
+static void k_project(void *arg, long lo, long hi, int id) {
+  (void)id;
+  for (; lo < hi; lo++)
+    project_row(arg, lo, 0);
+}
+static void stage(struct dns *d, long k, long e) {
+  long m;
+  for (; k < e; k++) {
+    m = k * d->s;
+    d->U_hat[m] = d->U_hat0[m] + d->coef * d->dU[m];
+    d->V_hat[m] = d->V_hat0[m] + d->coef * d->dV[m];
+    d->W_hat[m] = d->W_hat0[m] + d->coef * d->dW[m];
+  }
+}
+static void k_stage(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  (void)id;
+  d = arg;
+  stage(d, lo * d->nf, hi * d->nf);
+}
+static void accumulate(struct dns *d, long k, long e) {
+  long m;
+  for (; k < e; k++) {
+    m = k * d->s;
+    d->U_hat1[m] += d->coef * d->dU[m];
+    d->V_hat1[m] += d->coef * d->dV[m];
+    d->W_hat1[m] += d->coef * d->dW[m];
+  }
+}
+static void k_accumulate(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  (void)id;
+  d = arg;
+  accumulate(d, lo * d->nf, hi * d->nf);
+}
+/* Second order Adams-Bashforth for the nonlinear term and Crank-Nicolson
+   for the viscous one:
+
+     (1 + c) u' = (1 - c) u + 3/2 n - 1/2 n0,   c = nu dt k^2 / 2
+
+   where n is dt times the dealiased and projected nonlinear term of u
+   and n0 that of the previous step, kept in U_hat0. Without the
+   history the kernel replaces u by n. */
+static void k_ab2(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long i, j, k, l, m;
+  double *kx, *ky, *kz, kk, c, mask;
+  int dealias;
+  fftw_complex P, nU, nV, nW;
+  (void)id;
+  d = arg;
+  kx = d->kx;
+  ky = d->ky;
+  kz = d->kz;
+  for (; lo < hi; lo++) {
+    i = lo / d->ny;
+    j = lo % d->ny;
+    dealias = (fabs(kx[i]) < d->kxmax) && (fabs(ky[j]) < d->kymax);
+    for (k = 0; k < d->nf; k++) {
+      l = lo * d->nf + k;
+      m = l * d->s;
+      kk = kx[i] * kx[i] + ky[j] * ky[j] + kz[k] * kz[k];
+      mask = (dealias && (fabs(kz[k]) < d->kzmax)) * d->dt;
+      nU = d->dU[m] * mask;
+      nV = d->dV[m] * mask;
+      nW = d->dW[m] * mask;
+      P = kk > 0 ? (nU * kx[i] + nV * ky[j] + nW * kz[k]) / kk : 0.0;
+      nU -= P * kx[i];
+      nV -= P * ky[j];
+      nW -= P * kz[k];
+      if (d->P_hat != NULL)
+        d->P_hat[l] = P;
+      if (d->history < 2) {
+        d->U_hat[m] = nU;
+        d->V_hat[m] = nV;
+        d->W_hat[m] = nW;
+        continue;
+      }
+      c = 0.5 * d->nu * d->dt * kk;
+      d->U_hat[m] =
+          ((1 - c) * d->U_hat[m] + 1.5 * nU - 0.5 * d->U_hat0[m]) / (1 + c);
+      d->V_hat[m] =
+          ((1 - c) * d->V_hat[m] + 1.5 * nV - 0.5 * d->V_hat0[m]) / (1 + c);
+      d->W_hat[m] =
+          ((1 - c) * d->W_hat[m] + 1.5 * nW - 0.5 * d->W_hat0[m]) / (1 + c);
+      d->U_hat0[m] = nU;
+      d->V_hat0[m] = nV;
+      d->W_hat0[m] = nW;
+    }
+  }
+}
+
+/* Explicit AVX2 and AVX-512 versions of the spectral kernels. They work
+   on the interleaved layout: multiplying by i is an in-lane swap of the
+   real and imaginary parts and a sign flip. kz2 and mask2 hold kz and the
+   dealiasing factor (dt or 0) duplicated for both parts of a mode. Rows
+   are not a multiple of the vector length, so the scalar code finishes
+   each row. */
+#ifdef __x86_64__
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2,fma")))
+#define AVX512 __attribute__((target("avx512f")))
+AVX2 static __m256d avx2_i(__m256d x) {
+  return _mm256_xor_pd(_mm256_permute_pd(x, 0x5),
+                       _mm256_set_pd(0.0, -0.0, 0.0, -0.0));
+}
+AVX2 static void k_curl_avx2(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, l;
+  __m256d xi, xj, z, u, v, w;
+  (void)id;
+  d = arg;
+  for (; lo < hi; lo++) {
+    xi = _mm256_set1_pd(d->kx[lo / d->ny]);
+    xj = _mm256_set1_pd(d->ky[lo % d->ny]);
+    for (k = 0; k + 2 <= d->nf; k += 2) {
+      l = lo * d->nf + k;
+      z = _mm256_loadu_pd(d->kz2 + 2 * k);
+      u = _mm256_loadu_pd((double *)(d->U_hat + l));
+      v = _mm256_loadu_pd((double *)(d->V_hat + l));
+      w = _mm256_loadu_pd((double *)(d->W_hat + l));
+      _mm256_storeu_pd((double *)(d->curlZ + l),
+                       avx2_i(_mm256_fmsub_pd(xi, v, _mm256_mul_pd(xj, u))));
+      _mm256_storeu_pd((double *)(d->curlY + l),
+                       avx2_i(_mm256_fmsub_pd(z, u, _mm256_mul_pd(xi, w))));
+      _mm256_storeu_pd((double *)(d->curlX + l),
+                       avx2_i(_mm256_fmsub_pd(xj, w, _mm256_mul_pd(z, v))));
+    }
+    curl_row(d, lo, k);
+  }
+}
+AVX2 static void k_project_avx2(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long i, j, k, l;
+  int dealias;
+  __m256d xi, xj, xy, nudt, z, kk, m, pos, inv, du, dv, dw, P, one, zero;
+  (void)id;
+  d = arg;
+  one = _mm256_set1_pd(1.0);
+  zero = _mm256_setzero_pd();
+  nudt = _mm256_set1_pd(d->nu * d->dt);
+  for (; lo < hi; lo++) {
+    i = lo / d->ny;
+    j = lo % d->ny;
+    dealias = (fabs(d->kx[i]) < d->kxmax) && (fabs(d->ky[j]) < d->kymax);
+    xi = _mm256_set1_pd(d->kx[i]);
+    xj = _mm256_set1_pd(d->ky[j]);
+    xy = _mm256_set1_pd(d->kx[i] * d->kx[i] + d->ky[j] * d->ky[j]);
+    for (k = 0; k + 2 <= d->nf; k += 2) {
+      l = lo * d->nf + k;
+      z = _mm256_loadu_pd(d->kz2 + 2 * k);
+      kk = _mm256_add_pd(xy, _mm256_mul_pd(z, z));
+      m = dealias ? _mm256_loadu_pd(d->mask2 + 2 * k) : zero;
+      du = _mm256_mul_pd(_mm256_loadu_pd((double *)(d->dU + l)), m);
+      dv = _mm256_mul_pd(_mm256_loadu_pd((double *)(d->dV + l)), m);
+      dw = _mm256_mul_pd(_mm256_loadu_pd((double *)(d->dW + l)), m);
+      pos = _mm256_cmp_pd(kk, zero, _CMP_GT_OQ);
+      inv = _mm256_and_pd(pos,
+                          _mm256_div_pd(one, _mm256_blendv_pd(one, kk, pos)));
+      P = _mm256_fmadd_pd(dw, z, _mm256_fmadd_pd(dv, xj, _mm256_mul_pd(du, xi)));
+      P = _mm256_mul_pd(P, inv);
+      kk = _mm256_mul_pd(nudt, kk);
+      du = _mm256_sub_pd(
+          du, _mm256_fmadd_pd(
+                  kk, _mm256_loadu_pd((double *)(d->U_hat + l)),
+                  _mm256_mul_pd(P, xi)));
+      dv = _mm256_sub_pd(
+          dv, _mm256_fmadd_pd(
+                  kk, _mm256_loadu_pd((double *)(d->V_hat + l)),
+                  _mm256_mul_pd(P, xj)));
+      dw = _mm256_sub_pd(
+          dw, _mm256_fmadd_pd(
+                  kk, _mm256_loadu_pd((double *)(d->W_hat + l)),
+                  _mm256_mul_pd(P, z)));
+      _mm256_storeu_pd((double *)(d->dU + l), du);
+      _mm256_storeu_pd((double *)(d->dV + l), dv);
+      _mm256_storeu_pd((double *)(d->dW + l), dw);
+      if (d->P_hat != NULL)
+        _mm256_storeu_pd((double *)(d->P_hat + l), P);
+    }
+    project_row(d, lo, k);
+  }
+}
+AVX2 static void k_stage_avx2(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, e;
+  double *U, *V, *W, *U0, *V0, *W0, *dU, *dV, *dW;
+  __m256d c;
+  (void)id;
+  d = arg;
+  U = (double *)d->U_hat;
+  V = (double *)d->V_hat;
+  W = (double *)d->W_hat;
+  U0 = (double *)d->U_hat0;
+  V0 = (double *)d->V_hat0;
+  W0 = (double *)d->W_hat0;
+  dU = (double *)d->dU;
+  dV = (double *)d->dV;
+  dW = (double *)d->dW;
+  c = _mm256_set1_pd(d->coef);
+  e = 2 * hi * d->nf;
+  for (k = 2 * lo * d->nf; k + 4 <= e; k += 4) {
+    _mm256_storeu_pd(U + k, _mm256_fmadd_pd(c, _mm256_loadu_pd(dU + k),
+                                            _mm256_loadu_pd(U0 + k)));
+    _mm256_storeu_pd(V + k, _mm256_fmadd_pd(c, _mm256_loadu_pd(dV + k),
+                                            _mm256_loadu_pd(V0 + k)));
+    _mm256_storeu_pd(W + k, _mm256_fmadd_pd(c, _mm256_loadu_pd(dW + k),
+                                            _mm256_loadu_pd(W0 + k)));
+  }
+  stage(d, k / 2, e / 2);
+}
+AVX2 static void k_accumulate_avx2(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, e;
+  double *U, *V, *W, *dU, *dV, *dW;
+  __m256d c;
+  (void)id;
+  d = arg;
+  U = (double *)d->U_hat1;
+  V = (double *)d->V_hat1;
+  W = (double *)d->W_hat1;
+  dU = (double *)d->dU;
+  dV = (double *)d->dV;
+  dW = (double *)d->dW;
+  c = _mm256_set1_pd(d->coef);
+  e = 2 * hi * d->nf;
+  for (k = 2 * lo * d->nf; k + 4 <= e; k += 4) {
+    _mm256_storeu_pd(U + k, _mm256_fmadd_pd(c, _mm256_loadu_pd(dU + k),
+                                            _mm256_loadu_pd(U + k)));
+    _mm256_storeu_pd(V + k, _mm256_fmadd_pd(c, _mm256_loadu_pd(dV + k),
+                                            _mm256_loadu_pd(V + k)));
+    _mm256_storeu_pd(W + k, _mm256_fmadd_pd(c, _mm256_loadu_pd(dW + k),
+                                            _mm256_loadu_pd(W + k)));
+  }
+  accumulate(d, k / 2, e / 2);
+}
+AVX512 static __m512d avx512_i(__m512d x) {
+  return _mm512_castsi512_pd(_mm512_xor_si512(
+      _mm512_castpd_si512(_mm512_permute_pd(x, 0x55)),
+      _mm512_castpd_si512(
+          _mm512_set_pd(0.0, -0.0, 0.0, -0.0, 0.0, -0.0, 0.0, -0.0))));
+}
+AVX512 static void k_curl_avx512(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, l;
+  __m512d xi, xj, z, u, v, w;
+  (void)id;
+  d = arg;
+  for (; lo < hi; lo++) {
+    xi = _mm512_set1_pd(d->kx[lo / d->ny]);
+    xj = _mm512_set1_pd(d->ky[lo % d->ny]);
+    for (k = 0; k + 4 <= d->nf; k += 4) {
+      l = lo * d->nf + k;
+      z = _mm512_loadu_pd(d->kz2 + 2 * k);
+      u = _mm512_loadu_pd((double *)(d->U_hat + l));
+      v = _mm512_loadu_pd((double *)(d->V_hat + l));
+      w = _mm512_loadu_pd((double *)(d->W_hat + l));
+      _mm512_storeu_pd(
+          (double *)(d->curlZ + l),
+          avx512_i(_mm512_fmsub_pd(xi, v, _mm512_mul_pd(xj, u))));
+      _mm512_storeu_pd(
+          (double *)(d->curlY + l),
+          avx512_i(_mm512_fmsub_pd(z, u, _mm512_mul_pd(xi, w))));
+      _mm512_storeu_pd(
+          (double *)(d->curlX + l),
+          avx512_i(_mm512_fmsub_pd(xj, w, _mm512_mul_pd(z, v))));
+    }
+    curl_row(d, lo, k);
+  }
+}
+AVX512 static void k_project_avx512(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long i, j, k, l;
+  int dealias;
+  __mmask8 pos;
+  __m512d xi, xj, xy, nudt, z, kk, m, inv, du, dv, dw, P, one, zero;
+  (void)id;
+  d = arg;
+  one = _mm512_set1_pd(1.0);
+  zero = _mm512_setzero_pd();
+  nudt = _mm512_set1_pd(d->nu * d->dt);
+  for (; lo < hi; lo++) {
+    i = lo / d->ny;
+    j = lo % d->ny;
+    dealias = (fabs(d->kx[i]) < d->kxmax) && (fabs(d->ky[j]) < d->kymax);
+    xi = _mm512_set1_pd(d->kx[i]);
+    xj = _mm512_set1_pd(d->ky[j]);
+    xy = _mm512_set1_pd(d->kx[i] * d->kx[i] + d->ky[j] * d->ky[j]);
+    for (k = 0; k + 4 <= d->nf; k += 4) {
+      l = lo * d->nf + k;
+      z = _mm512_loadu_pd(d->kz2 + 2 * k);
+      kk = _mm512_add_pd(xy, _mm512_mul_pd(z, z));
+      m = dealias ? _mm512_loadu_pd(d->mask2 + 2 * k) : zero;
+      du = _mm512_mul_pd(_mm512_loadu_pd((double *)(d->dU + l)), m);
+      dv = _mm512_mul_pd(_mm512_loadu_pd((double *)(d->dV + l)), m);
+      dw = _mm512_mul_pd(_mm512_loadu_pd((double *)(d->dW + l)), m);
+      pos = _mm512_cmp_pd_mask(kk, zero, _CMP_GT_OQ);
+      inv = _mm512_maskz_div_pd(pos, one, kk);
+      P = _mm512_fmadd_pd(dw, z, _mm512_fmadd_pd(dv, xj, _mm512_mul_pd(du, xi)));
+      P = _mm512_mul_pd(P, inv);
+      kk = _mm512_mul_pd(nudt, kk);
+      du = _mm512_sub_pd(
+          du, _mm512_fmadd_pd(
+                  kk, _mm512_loadu_pd((double *)(d->U_hat + l)),
+                  _mm512_mul_pd(P, xi)));
+      dv = _mm512_sub_pd(
+          dv, _mm512_fmadd_pd(
+                  kk, _mm512_loadu_pd((double *)(d->V_hat + l)),
+                  _mm512_mul_pd(P, xj)));
+      dw = _mm512_sub_pd(
+          dw, _mm512_fmadd_pd(
+                  kk, _mm512_loadu_pd((double *)(d->W_hat + l)),
+                  _mm512_mul_pd(P, z)));
+      _mm512_storeu_pd((double *)(d->dU + l), du);
+      _mm512_storeu_pd((double *)(d->dV + l), dv);
+      _mm512_storeu_pd((double *)(d->dW + l), dw);
+      if (d->P_hat != NULL)
+        _mm512_storeu_pd((double *)(d->P_hat + l), P);
+    }
+    project_row(d, lo, k);
+  }
+}
+AVX512 static void k_stage_avx512(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, e;
+  double *U, *V, *W, *U0, *V0, *W0, *dU, *dV, *dW;
+  __m512d c;
+  (void)id;
+  d = arg;
+  U = (double *)d->U_hat;
+  V = (double *)d->V_hat;
+  W = (double *)d->W_hat;
+  U0 = (double *)d->U_hat0;
+  V0 = (double *)d->V_hat0;
+  W0 = (double *)d->W_hat0;
+  dU = (double *)d->dU;
+  dV = (double *)d->dV;
+  dW = (double *)d->dW;
+  c = _mm512_set1_pd(d->coef);
+  e = 2 * hi * d->nf;
+  for (k = 2 * lo * d->nf; k + 8 <= e; k += 8) {
+    _mm512_storeu_pd(U + k, _mm512_fmadd_pd(c, _mm512_loadu_pd(dU + k),
+                                            _mm512_loadu_pd(U0 + k)));
+    _mm512_storeu_pd(V + k, _mm512_fmadd_pd(c, _mm512_loadu_pd(dV + k),
+                                            _mm512_loadu_pd(V0 + k)));
+    _mm512_storeu_pd(W + k, _mm512_fmadd_pd(c, _mm512_loadu_pd(dW + k),
+                                            _mm512_loadu_pd(W0 + k)));
+  }
+  for (; k < e; k++) {
+    U[k] = U0[k] + d->coef * dU[k];
+    V[k] = V0[k] + d->coef * dV[k];
+    W[k] = W0[k] + d->coef * dW[k];
+  }
+}
+AVX512 static void k_accumulate_avx512(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, e;
+  double *U, *V, *W, *dU, *dV, *dW;
+  __m512d c;
+  (void)id;
+  d = arg;
+  U = (double *)d->U_hat1;
+  V = (double *)d->V_hat1;
+  W = (double *)d->W_hat1;
+  dU = (double *)d->dU;
+  dV = (double *)d->dV;
+  dW = (double *)d->dW;
+  c = _mm512_set1_pd(d->coef);
+  e = 2 * hi * d->nf;
+  for (k = 2 * lo * d->nf; k + 8 <= e; k += 8) {
+    _mm512_storeu_pd(U + k, _mm512_fmadd_pd(c, _mm512_loadu_pd(dU + k),
+                                            _mm512_loadu_pd(U + k)));
+    _mm512_storeu_pd(V + k, _mm512_fmadd_pd(c, _mm512_loadu_pd(dV + k),
+                                            _mm512_loadu_pd(V + k)));
+    _mm512_storeu_pd(W + k, _mm512_fmadd_pd(c, _mm512_loadu_pd(dW + k),
+                                            _mm512_loadu_pd(W + k)));
+  }
+  for (; k < e; k++) {
+    U[k] += d->coef * dU[k];
+    V[k] += d->coef * dV[k];
+    W[k] += d->coef * dW[k];
+  }
+}
+#endif
+static const struct kernels {
+  const char *name;
+  void (*curl)(void *, long, long, int);
+  void (*project)(void *, long, long, int);
+  void (*stage)(void *, long, long, int);
+  void (*accumulate)(void *, long, long, int);
+} kernels[] = {
+    {"scalar", k_curl, k_project, k_stage, k_accumulate},
+#ifdef __x86_64__
+    {"avx2", k_curl_avx2, k_project_avx2, k_stage_avx2, k_accumulate_avx2},
+    {"avx512", k_curl_avx512, k_project_avx512, k_stage_avx512,
+     k_accumulate_avx512},
+#endif
+};
+static int kernels_supported(const struct kernels *kern) {
+#ifdef __x86_64__
+  if (strcmp(kern->name, "avx2") == 0)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (strcmp(kern->name, "avx512") == 0)
+    return __builtin_cpu_supports("avx512f");
+#endif
+  return 1;
+}
+static void k_finish(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k, m;
+  (void)id;
+  d = arg;
+  for (k = lo * d->nf; k < hi * d->nf; k++) {
+    m = k * d->s;
+    d->U_hat[m] = d->U_hat1[m];
+    d->V_hat[m] = d->V_hat1[m];
+    d->W_hat[m] = d->W_hat1[m];
+  }
+}
+/* Out-of-core transforms (dns_param.ooc). The arena is a file mapped
+   shared, so the fields live in the page cache backed by the disk, and a
+   3D transform is done in passes over slabs: the 2D transforms of the nx
+   yz-planes (fplan and bplan), then the transforms along x of blocks of
+   block of the ny * nf columns of the spectral field (xplan: forward and
+   backward of a full block, then of the last one). Each pass advises the
+   kernel to read the next slab ahead, so the disk works while FFTW
+   computes. When the arena is larger than the RAM (behind) the planes
+   written are also queued for writeback at once; below that the
+   writeback of the kernel is faster, and for the strided blocks of
+   columns always. */
+static void ooc_advise(struct dns *d, void *p, size_t size, int write) {
+  const size_t page = 4096;
+  size_t lo, hi;
+  lo = ((char *)p - d->arena) / page * page;
+  hi = ((char *)p - d->arena + size + page - 1) / page * page;
+  if (write) {
+    if (d->behind)
+      sync_file_range(d->fd, lo, hi - lo, SYNC_FILE_RANGE_WRITE);
+  } else
+    madvise(d->arena + lo, hi - lo, MADV_WILLNEED);
+}
+static void ooc_planes(struct dns *d, fftw_plan plan, double *real,
+                       fftw_complex *hat, int forward) {
+  long i, pr, pc;
+  pr = d->ny * d->ld;
+  pc = d->ny * d->nf;
+  for (i = 0; i < d->nx; i++) {
+    if (i + 1 < d->nx) {
+      ooc_advise(d, real + (i + 1) * pr, pr * sizeof(double), 0);
+      ooc_advise(d, hat + (i + 1) * pc, pc * sizeof(fftw_complex), 0);
+    }
+    if (forward) {
+      fftw_execute_dft_r2c(plan, real + i * pr, hat + i * pc);
+      ooc_advise(d, hat + i * pc, pc * sizeof(fftw_complex), 1);
+    } else {
+      fftw_execute_dft_c2r(plan, hat + i * pc, real + i * pr);
+      ooc_advise(d, real + i * pr, pr * sizeof(double), 1);
+    }
+  }
+}
+static void ooc_columns(struct dns *d, fftw_complex *hat, int forward) {
+  long i, c, w, next, cols;
+  cols = d->ny * d->nf;
+  for (c = 0; c < cols; c += d->block) {
+    w = cols - c < d->block ? cols - c : d->block;
+    next = cols - c - w < d->block ? cols - c - w : d->block;
+    if (next > 0)
+      for (i = 0; i < d->nx; i++)
+        ooc_advise(d, hat + i * cols + c + w, next * sizeof(fftw_complex), 0);
+    fftw_execute_dft(d->xplan[2 * (w < d->block) + !forward], hat + c,
+                     hat + c);
+  }
+}
+static void fft_r2c(fftw_plan plan, struct dns *d, double *real,
+                    fftw_complex *hat) {
+  double t;
+  t = d->status != NULL ? now() : 0;
+  if (d->fd < 0)
+    fftw_execute_dft_r2c(plan, real, hat);
+  else {
+    ooc_planes(d, plan, real, hat, 1);
+    ooc_columns(d, hat, 1);
+  }
+  if (d->status != NULL)
+    d->clock[0] += now() - t;
+}
+static void fft_c2r(fftw_plan plan, struct dns *d, fftw_complex *hat,
+                    double *real) {
+  double t;
+  t = d->status != NULL ? now() : 0;
+  if (d->fd < 0)
+    fftw_execute_dft_c2r(plan, hat, real);
+  else {
+    ooc_columns(d, hat, 0);
+    ooc_planes(d, plan, real, hat, 0);
+  }
+  if (d->status != NULL)
+    d->clock[0] += now() - t;
+}
+/* c2r destroys its input: transform a copy in work, or, when work is NULL,
+   copy into the padded real array and transform in place */
+static void c2r(fftw_plan fplan, struct dns *d, fftw_complex *hat, double *real,
+                fftw_complex *work) {
+  d->src = hat;
+  d->dst = work != NULL ? work : (fftw_complex *)real;
+  phase_for(d, phase_copy, d->nx * d->ny, k_copy, d);
+  fft_c2r(fplan, d, d->dst, real);
+}
+/* Transform a vector field: one batched plan for the interleaved layout,
+   a scalar plan per component otherwise */
+static void r2c3(fftw_plan fplan, struct dns *d, double *U, double *V,
+                 double *W, fftw_complex *U_hat, fftw_complex *V_hat,
+                 fftw_complex *W_hat) {
+  fft_r2c(fplan, d, U, U_hat);
+  if (d->s == 1) {
+    fft_r2c(fplan, d, V, V_hat);
+    fft_r2c(fplan, d, W, W_hat);
+  }
+}
+static void c2r3(fftw_plan bplan, struct dns *d, fftw_complex *U_hat,
+                 fftw_complex *V_hat, fftw_complex *W_hat, double *U, double *V,
+                 double *W) {
+  fft_c2r(bplan, d, U_hat, U);
+  if (d->s == 1) {
+    fft_c2r(bplan, d, V_hat, V);
+    fft_c2r(bplan, d, W_hat, W);
+  }
+}
+static double *field(struct dns *d, int c) {
+  return c == 0 ? d->U : c == 1 ? d->V : d->W;
+}
+/* Tracer particles (in-situ request tracers). They start at uniformly
+   random positions drawn from a hash of their number and are advanced
+   with the stages of the time step by the velocity interpolated from
+   the physical fields: trilinear (order 2) or cubic B-spline (order 4).
+   The B-spline coefficients are the velocity divided in spectral space
+   by the transform of the sampled spline, (4 + 2 cos(k dx)) / 6 per
+   axis, so the interpolant passes through the grid values; they are
+   transformed into the buffers of the curl, free at that point of the
+   step, which the minimal mode does not have.
+
+   Positions are unwrapped. Before the first stage of every step the
+   particles are sorted by bins of bin^3 grid cells so that the threads
+   interpolate from neighbouring memory; id keeps the number of every
+   particle for the output. */
+enum { tracers_bin = 4 };
+struct tracers {
+  long n, every, nb[3], *id, *perm, *count, *key;
+  int order, stage, record;
+  double *x, *xs, *acc, *prev, *tmp, *fx, *fy, *fz;
+  float *buf;
+  struct dns *d;
+};
+static uint64_t splitmix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+/* Uniform in [0, 1) */
+static double uniform(uint64_t *h) {
+  *h = splitmix(*h);
+  return (*h >> 11) * 0x1.0p-53;
+}
+/* Index of the grid point left of x and the distance to it in units of
+   the spacing */
+static long cell(double x, double L, long n, double *f) {
+  double u;
+  long i;
+  u = x / L * n;
+  i = (long)floor(u);
+  *f = u - i;
+  return (i % n + n) % n;
+}
+static void k_key(void *arg, long lo, long hi, int id) {
+  struct tracers *tr;
+  struct dns *d;
+  double f;
+  long i, j, k;
+  (void)id;
+  tr = arg;
+  d = tr->d;
+  for (; lo < hi; lo++) {
+    i = cell(tr->x[3 * lo], d->Lx, d->nx, &f) / tracers_bin;
+    j = cell(tr->x[3 * lo + 1], d->Ly, d->ny, &f) / tracers_bin;
+    k = cell(tr->x[3 * lo + 2], d->Lz, d->nz, &f) / tracers_bin;
+    tr->key[lo] = (i * tr->nb[1] + j) * tr->nb[2] + k;
+  }
+}
+static void k_permute(void *arg, long lo, long hi, int id) {
+  struct tracers *tr;
+  long p;
+  int c;
+  (void)id;
+  tr = arg;
+  for (; lo < hi; lo++) {
+    p = tr->perm[lo];
+    for (c = 0; c < 3; c++) {
+      tr->tmp[3 * lo + c] = tr->x[3 * p + c];
+      tr->xs[3 * lo + c] = tr->prev[3 * p + c];
+    }
+    tr->key[lo] = tr->id[p];
+  }
+}
+/* Stable counting sort by bin; xs and key are free before the first
+   stage and hold the permuted prev and id */
+static void tracers_sort(struct tracers *tr) {
+  long i, nbin, sum, t;
+  double *p;
+  long *q;
+  nbin = tr->nb[0] * tr->nb[1] * tr->nb[2];
+  pool_for(tr->n, k_key, tr);
+  memset(tr->count, 0, nbin * sizeof(long));
+  for (i = 0; i < tr->n; i++)
+    tr->count[tr->key[i]]++;
+  for (sum = i = 0; i < nbin; i++) {
+    t = tr->count[i];
+    tr->count[i] = sum;
+    sum += t;
+  }
+  for (i = 0; i < tr->n; i++)
+    tr->perm[tr->count[tr->key[i]]++] = i;
+  pool_for(tr->n, k_permute, tr);
+  p = tr->x;
+  tr->x = tr->tmp;
+  tr->tmp = p;
+  p = tr->prev;
+  tr->prev = tr->xs;
+  tr->xs = p;
+  q = tr->id;
+  tr->id = tr->key;
+  tr->key = q;
+}
+static void interpolate(struct tracers *tr, const double *x, double *u) {
+  struct dns *d;
+  double f[3], w[3][4], *U, *V, *W, v;
+  long o[3][4], i0[3], i, j, k, l, m;
+  int c, p, e;
+  d = tr->d;
+  i0[0] = cell(x[0], d->Lx, d->nx, &f[0]);
+  i0[1] = cell(x[1], d->Ly, d->ny, &f[1]);
+  i0[2] = cell(x[2], d->Lz, d->nz, &f[2]);
+  for (c = 0; c < 3; c++) {
+    if (tr->order == 2) {
+      w[c][0] = 1 - f[c];
+      w[c][1] = f[c];
+    } else {
+      w[c][0] = (1 - f[c]) * (1 - f[c]) * (1 - f[c]) / 6;
+      w[c][1] = (3 * f[c] * f[c] * f[c] - 6 * f[c] * f[c] + 4) / 6;
+      w[c][2] =
+          (-3 * f[c] * f[c] * f[c] + 3 * f[c] * f[c] + 3 * f[c] + 1) / 6;
+      w[c][3] = f[c] * f[c] * f[c] / 6;
+    }
+  }
+  /* offsets of the stencil points in the arrays */
+  for (p = 0; p < tr->order; p++) {
+    e = tr->order == 2 ? p : p - 1;
+    o[0][p] = (i0[0] + e + d->nx) % d->nx * d->ny;
+    o[1][p] = (i0[1] + e + d->ny) % d->ny;
+    o[2][p] = (i0[2] + e + d->nz) % d->nz * d->s;
+  }
+  if (tr->order == 2) {
+    U = d->U;
+    V = d->V;
+    W = d->W;
+  } else {
+    U = d->CU;
+    V = d->CV;
+    W = d->CW;
+  }
+  u[0] = u[1] = u[2] = 0;
+  for (i = 0; i < tr->order; i++)
+    for (j = 0; j < tr->order; j++) {
+      l = (o[0][i] + o[1][j]) * d->ld * d->s;
+      for (k = 0; k < tr->order; k++) {
+        m = l + o[2][k];
+        v = w[0][i] * w[1][j] * w[2][k];
+        u[0] += v * U[m];
+        u[1] += v * V[m];
+        u[2] += v * W[m];
+      }
+    }
+}
+/* One stage: the fourth order Runge-Kutta scheme, or second order
+   Adams-Bashforth with the velocity of the previous step in prev */
+static void k_tracers(void *arg, long lo, long hi, int id) {
+  struct tracers *tr;
+  struct dns *d;
+  double u[3], dt;
+  float *buf;
+  int c;
+  (void)id;
+  tr = arg;
+  d = tr->d;
+  dt = d->dt;
+  for (; lo < hi; lo++) {
+    interpolate(tr, tr->stage == 0 ? &tr->x[3 * lo] : &tr->xs[3 * lo], u);
+    if (tr->record) {
+      buf = tr->buf + 6 * tr->id[lo];
+      for (c = 0; c < 3; c++) {
+        buf[c] = tr->x[3 * lo + c];
+        buf[c + 3] = u[c];
+      }
+    }
+    for (c = 0; c < 3; c++) {
+      if (d->ab2 && d->history == 2) {
+        tr->x[3 * lo + c] += dt * (1.5 * u[c] - 0.5 * tr->prev[3 * lo + c]);
+        tr->prev[3 * lo + c] = u[c];
+        continue;
+      }
+      switch (tr->stage) {
+      case 0:
+        tr->acc[3 * lo + c] = u[c];
+        tr->prev[3 * lo + c] = u[c];
+        tr->xs[3 * lo + c] = tr->x[3 * lo + c] + 0.5 * dt * u[c];
+        break;
+      case 1:
+      case 2:
+        tr->acc[3 * lo + c] += 2 * u[c];
+        tr->xs[3 * lo + c] =
+            tr->x[3 * lo + c] + (tr->stage == 1 ? 0.5 : 1.0) * dt * u[c];
+        break;
+      default:
+        tr->x[3 * lo + c] += dt / 6 * (tr->acc[3 * lo + c] + u[c]);
+        break;
+      }
+    }
+  }
+}
+static void k_bspline(void *arg, long lo, long hi, int id) {
+  struct tracers *tr;
+  struct dns *d;
+  long i, j, k, m;
+  double f;
+  (void)id;
+  tr = arg;
+  d = tr->d;
+  for (; lo < hi; lo++) {
+    i = lo / d->ny;
+    j = lo % d->ny;
+    for (k = 0; k < d->nf; k++) {
+      m = (lo * d->nf + k) * d->s;
+      f = tr->fx[i] * tr->fy[j] * tr->fz[k];
+      d->curlX[m] = f * d->U_hat[m];
+      d->curlY[m] = f * d->V_hat[m];
+      d->curlZ[m] = f * d->W_hat[m];
+    }
+  }
+}
+static double bspline_filter(long i, long n) {
+  return 6 / (4 + 2 * cos(2 * pi * i / n));
+}
+static struct tracers *tracers_new(struct dns *d, long n, int order) {
+  struct tracers *tr;
+  uint64_t h;
+  long i;
+  tr = calloc(1, sizeof *tr);
+  tr->d = d;
+  tr->n = n;
+  tr->order = order;
+  tr->nb[0] = (d->nx + tracers_bin - 1) / tracers_bin;
+  tr->nb[1] = (d->ny + tracers_bin - 1) / tracers_bin;
+  tr->nb[2] = (d->nz + tracers_bin - 1) / tracers_bin;
+  tr->x = malloc(3 * n * sizeof(double));
+  tr->xs = malloc(3 * n * sizeof(double));
+  tr->acc = malloc(3 * n * sizeof(double));
+  tr->prev = malloc(3 * n * sizeof(double));
+  tr->tmp = malloc(3 * n * sizeof(double));
+  tr->id = malloc(n * sizeof(long));
+  tr->perm = malloc(n * sizeof(long));
+  tr->key = malloc(n * sizeof(long));
+  tr->count = malloc(tr->nb[0] * tr->nb[1] * tr->nb[2] * sizeof(long));
+  tr->buf = malloc(6 * n * sizeof(float));
+  for (i = 0; i < n; i++) {
+    h = splitmix(i);
+    tr->x[3 * i] = d->Lx * uniform(&h);
+    tr->x[3 * i + 1] = d->Ly * uniform(&h);
+    tr->x[3 * i + 2] = d->Lz * uniform(&h);
+    tr->prev[3 * i] = tr->prev[3 * i + 1] = tr->prev[3 * i + 2] = 0;
+    tr->id[i] = i;
+  }
+  if (order == 4) {
+    tr->fx = malloc(d->nx * sizeof(double));
+    tr->fy = malloc(d->ny * sizeof(double));
+    tr->fz = malloc(d->nf * sizeof(double));
+    for (i = 0; i < d->nx; i++)
+      tr->fx[i] = bspline_filter(i, d->nx) * d->invN;
+    for (i = 0; i < d->ny; i++)
+      tr->fy[i] = bspline_filter(i, d->ny);
+    for (i = 0; i < d->nf; i++)
+      tr->fz[i] = bspline_filter(i, d->nz);
+  }
+  return tr;
+}
+/* Advance the tracers with the physical velocity of stage (0 to 3) of
+   a step */
+static void tracers_stage(struct tracers *tr, int stage, int record) {
+  struct dns *d;
+  d = tr->d;
+  if (stage == 0)
+    tracers_sort(tr);
+  if (tr->order == 4) {
+    pool_for(d->nx * d->ny, k_bspline, tr);
+    c2r3(d->bplan, d, d->curlX, d->curlY, d->curlZ, d->CU, d->CV, d->CW);
+  }
+  tr->stage = stage;
+  tr->record = record;
+  pool_for(tr->n, k_tracers, tr);
+}
+static void tracers_free(struct tracers *tr) {
+  free(tr->x);
+  free(tr->xs);
+  free(tr->acc);
+  free(tr->prev);
+  free(tr->tmp);
+  free(tr->id);
+  free(tr->perm);
+  free(tr->key);
+  free(tr->count);
+  free(tr->buf);
+  free(tr->fx);
+  free(tr->fy);
+  free(tr->fz);
+  free(tr);
+}
+/* In-situ output configured by a file (dns -o <file>), one request per
+   line:
+
+     stats <every>                    min, max and RMS of U, V and W
+     probe <x> <y> <z> <every>        U, V, W interpolated at a point
+     plane <x|y|z> <index> <every>    U, V, W on a grid plane
+     down <factor> <every>            U, V, W averaged over factor^3 cells
+     tracers <n> <linear|bspline> <every>
+                                      positions and velocities of n
+                                      tracer particles
+
+   Samples are taken every <every> steps from the physical fields of the
+   first Runge-Kutta stage, i.e., at the time printed on stdout. stats
+   and probes append text lines to stats.dat and probe.<i>.dat (i counts
+   the probes from 0); planes and volumes append float64 records of
+   three blocks to plane.<axis>.<index>.raw and down.<factor>.raw. A
+   plane block has the grid size of the two other axes in their order,
+   a volume block (nx / factor) * (ny / factor) * (nz / factor) points.
+   tracers appends float32 records of x, y, z, u, v, w of every particle
+   in the order of their numbers to tracers.raw. Empty lines and lines
+   starting with # are skipped. */
+enum { insitu_stats, insitu_probe, insitu_plane, insitu_down, insitu_tracers };
+struct insitu {
+  int type, axis;
+  long every, index, factor;
+  double x[3], *buf;
+  FILE *file;
+  struct dns *d;
+};
+static double at(struct dns *d, double *u, long i, long j, long k) {
+  return u[((i * d->ny + j) * d->ld + k) * d->s];
+}
+static void k_stats(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long k;
+  int c;
+  double *stats, *u, x;
+  d = arg;
+  stats = d->stats + 9 * id;
+  for (; lo < hi; lo++)
+    for (c = 0; c < 3; c++) {
+      u = field(d, c) + lo * d->ld * d->s;
+      for (k = 0; k < d->nz; k++) {
+        x = u[k * d->s];
+        stats[3 * c] = fmin(stats[3 * c], x);
+        stats[3 * c + 1] = fmax(stats[3 * c + 1], x);
+        stats[3 * c + 2] += x * x;
+      }
+    }
+}
+static void k_down(void *arg, long lo, long hi, int id) {
+  struct insitu *q;
+  struct dns *d;
+  long f, nx, ny, nz, i, j, k, ii, jj, kk;
+  int c;
+  double sum;
+  (void)id;
+  q = arg;
+  d = q->d;
+  f = q->factor;
+  nx = d->nx / f;
+  ny = d->ny / f;
+  nz = d->nz / f;
+  for (; lo < hi; lo++) {
+    i = lo / ny;
+    j = lo % ny;
+    for (c = 0; c < 3; c++)
+      for (k = 0; k < nz; k++) {
+        sum = 0;
+        for (ii = i * f; ii < (i + 1) * f; ii++)
+          for (jj = j * f; jj < (j + 1) * f; jj++)
+            for (kk = k * f; kk < (k + 1) * f; kk++)
+              sum += at(d, field(d, c), ii, jj, kk);
+        q->buf[((c * nx + i) * ny + j) * nz + k] = sum / (f * f * f);
+      }
+  }
+}
+static void insitu_write(struct dns *d, struct insitu *q, int nthreads,
+                         long tstep, double t) {
+  long n[3], i, j, k, i0[3], i1[3], n0, n1, f;
+  int c, id;
+  double L[3], w[3], u, stats[9];
+  n[0] = d->nx;
+  n[1] = d->ny;
+  n[2] = d->nz;
+  L[0] = d->Lx;
+  L[1] = d->Ly;
+  L[2] = d->Lz;
+  switch (q->type) {
+  case insitu_stats:
+    /* members without rows leave their slot as it is */
+    for (id = 0; id < nthreads; id++)
+      for (c = 0; c < 3; c++) {
+        d->stats[9 * id + 3 * c] = INFINITY;
+        d->stats[9 * id + 3 * c + 1] = -INFINITY;
+        d->stats[9 * id + 3 * c + 2] = 0;
+      }
+    pool_for(n[0] * n[1], k_stats, d);
+    for (c = 0; c < 3; c++) {
+      stats[3 * c] = INFINITY;
+      stats[3 * c + 1] = -INFINITY;
+      stats[3 * c + 2] = 0;
+      for (id = 0; id < nthreads; id++) {
+        stats[3 * c] = fmin(stats[3 * c], d->stats[9 * id + 3 * c]);
+        stats[3 * c + 1] = fmax(stats[3 * c + 1], d->stats[9 * id + 3 * c + 1]);
+        stats[3 * c + 2] += d->stats[9 * id + 3 * c + 2];
+      }
+      stats[3 * c + 2] = sqrt(stats[3 * c + 2] * d->invN);
+    }
+    fprintf(q->file, "% 10ld % .16e", tstep, t);
+    for (c = 0; c < 9; c++)
+      fprintf(q->file, " % .16e", stats[c]);
+    fprintf(q->file, "\n");
+    break;
+  case insitu_probe:
+    for (c = 0; c < 3; c++) {
+      u = q->x[c] / L[c] * n[c];
+      i0[c] = (long)floor(u);
+      w[c] = u - i0[c];
+      i0[c] = (i0[c] % n[c] + n[c]) % n[c];
+      i1[c] = (i0[c] + 1) % n[c];
+    }
+    fprintf(q->file, "% 10ld % .16e", tstep, t);
+    for (c = 0; c < 3; c++) {
+      u = 0;
+      for (i = 0; i < 2; i++)
+        for (j = 0; j < 2; j++)
+          for (k = 0; k < 2; k++)
+            u += (i ? w[0] : 1 - w[0]) * (j ? w[1] : 1 - w[1]) *
+                 (k ? w[2] : 1 - w[2]) *
+                 at(d, field(d, c), i ? i1[0] : i0[0], j ? i1[1] : i0[1],
+                    k ? i1[2] : i0[2]);
+      fprintf(q->file, " % .16e", u);
+    }
+    fprintf(q->file, "\n");
+    break;
+  case insitu_plane:
+    n0 = n[q->axis == 0];
+    n1 = n[q->axis == 2 ? 1 : 2];
+    for (c = 0; c < 3; c++)
+      for (i = 0; i < n0; i++)
+        for (j = 0; j < n1; j++)
+          q->buf[(c * n0 + i) * n1 + j] =
+              q->axis == 0   ? at(d, field(d, c), q->index, i, j)
+              : q->axis == 1 ? at(d, field(d, c), i, q->index, j)
+                             : at(d, field(d, c), i, j, q->index);
+    fwrite(q->buf, 3 * n0 * n1, sizeof(double), q->file);
+    break;
+  case insitu_down:
+    f = q->factor;
+    pool_for(n[0] / f * (n[1] / f), k_down, q);
+    fwrite(q->buf, 3 * (n[0] / f) * (n[1] / f) * (n[2] / f), sizeof(double),
+           q->file);
+    break;
+  case insitu_tracers:
+    fwrite(d->tr->buf, 6 * d->tr->n, sizeof(float), q->file);
+    break;
+  }
+  fflush(q->file);
+}
+/* Append the requests of path to d->q; on error the request being read
+   is dropped and dns_destroy closes the others */
+static int insitu_read(const char *path, struct dns *d) {
+  FILE *file;
+  char line[1024], word[1024], name[FILENAME_MAX], axis, interp[1024];
+  struct insitu *p;
+  int lineno, nprobe, nstats, cnt;
+  long n[3], f, ntracers;
+  if ((file = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "dns: error: fail to open '%s'\n", path);
+    return -1;
+  }
+  n[0] = d->nx;
+  n[1] = d->ny;
+  n[2] = d->nz;
+  nprobe = 0;
+  nstats = 0;
+  for (lineno = 1; fgets(line, sizeof line, file) != NULL; lineno++) {
+    if (sscanf(line, "%1023s", word) != 1 || word[0] == '#')
+      continue;
+    d->q = realloc(d->q, (d->nq + 1) * sizeof *d->q);
+    p = &d->q[d->nq];
+    memset(p, 0, sizeof *p);
+    p->d = d;
+    if (strcmp(word, "stats") == 0 &&
+        sscanf(line, "%*s %ld %n", &p->every, &cnt) == 1) {
+      p->type = insitu_stats;
+      sprintf(name, "stats.dat");
+      nstats++;
+    } else if (strcmp(word, "probe") == 0 &&
+               sscanf(line, "%*s %lf %lf %lf %ld %n", &p->x[0], &p->x[1],
+                      &p->x[2], &p->every, &cnt) == 4) {
+      p->type = insitu_probe;
+      sprintf(name, "probe.%d.dat", nprobe++);
+    } else if (strcmp(word, "plane") == 0 &&
+               sscanf(line, "%*s %c %ld %ld %n", &axis, &p->index, &p->every,
+                      &cnt) == 3 &&
+               axis >= 'x' && axis <= 'z' && p->index >= 0 &&
+               p->index < n[axis - 'x']) {
+      p->type = insitu_plane;
+      p->axis = axis - 'x';
+      p->buf = malloc(3 * n[0] * n[1] * n[2] / n[p->axis] * sizeof(double));
+      sprintf(name, "plane.%c.%04ld.raw", axis, p->index);
+    } else if (strcmp(word, "down") == 0 &&
+               sscanf(line, "%*s %ld %ld %n", &p->factor, &p->every, &cnt) ==
+                   2 &&
+               p->factor > 0 && n[0] % p->factor == 0 &&
+               n[1] % p->factor == 0 && n[2] % p->factor == 0) {
+      p->type = insitu_down;
+      f = p->factor;
+      p->buf =
+          malloc(3 * (n[0] / f) * (n[1] / f) * (n[2] / f) * sizeof(double));
+      sprintf(name, "down.%ld.raw", p->factor);
+    } else if (strcmp(word, "tracers") == 0 &&
+               sscanf(line, "%*s %ld %1023s %ld %n", &ntracers, interp,
+                      &p->every, &cnt) == 3 &&
+               ntracers > 0 &&
+               (strcmp(interp, "linear") == 0 ||
+                strcmp(interp, "bspline") == 0)) {
+      if (d->tr != NULL) {
+        fprintf(stderr, "dns: error: %s:%d: tracers are already requested\n",
+                path, lineno);
+        goto fail;
+      }
+      if (d->min && strcmp(interp, "bspline") == 0) {
+        fprintf(stderr, "dns: error: %s:%d: bspline tracers need the curl "
+                        "buffers, not available with -m\n",
+                path, lineno);
+        goto fail;
+      }
+      p->type = insitu_tracers;
+      d->tr = tracers_new(d, ntracers, strcmp(interp, "linear") == 0 ? 2 : 4);
+      d->tr->every = p->every;
+      sprintf(name, "tracers.raw");
+    } else {
+      fprintf(stderr, "dns: error: %s:%d: invalid request\n", path, lineno);
+      goto fail;
+    }
+    if (p->every <= 0 || line[cnt] != '\0') {
+      fprintf(stderr, "dns: error: %s:%d: invalid request\n", path, lineno);
+      goto fail;
+    }
+    if (nstats > 1) {
+      fprintf(stderr, "dns: error: %s:%d: stats is already requested\n", path,
+              lineno);
+      goto fail;
+    }
+    if ((p->file = fopen(name, p->type == insitu_plane ||
+                                       p->type == insitu_down ||
+                                       p->type == insitu_tracers
+                                   ? "wb"
+                                   : "w")) == NULL) {
+      fprintf(stderr, "dns: error: fail to open '%s'\n", name);
+      goto fail;
+    }
+    d->nq++;
+  }
+  fclose(file);
+  return 0;
+fail:
+  free(p->buf);
+  fclose(file);
+  return -1;
+}
+/* The field arrays are one arena mapped by dns_init. fields lays them
+   out twice: with no arena to add up its size, then to set the
+   pointers. The buffers are aligned to cache lines and set five lines
+   apart beyond their size: at the same offset modulo a power of two
+   the streams of a kernel compete for the same cache sets, which costs
+   a quarter of the step at n = 128. With verbose set the layout
+   is printed with the lifetime of each buffer: "run" holds the state
+   between steps, "step" lives through a time step, "stage" through one
+   evaluation of the nonlinear term and "output" through dns_field. */
+enum { arena_align = 64, arena_pad = 5 * 64 };
+static void *arena(struct dns *d, size_t size, const char *name, int c,
+                   const char *life) {
+  char label[32];
+  void *p;
+  size = (size + arena_align - 1) / arena_align * arena_align + arena_pad;
+  p = NULL;
+  if (d->arena != NULL) {
+    p = d->arena + d->arena_used;
+    if (d->verbose) {
+      if (c < 0)
+        snprintf(label, sizeof label, "%s", name);
+      else
+        snprintf(label, sizeof label, "%s[%d]", name, c);
+      fprintf(stderr, "dns: arena: %12zu %12zu %-10s %s\n", d->arena_used,
+              size, label, life);
+    }
+  }
+  d->arena_used += size;
+  return p;
+}
+/* A vector field of size elements per component */
+static void real3(struct dns *d, long size, double **U, double **V,
+                  double **W, const char *name, const char *life) {
+  if (d->s == 3) {
+    *U = arena(d, 3 * size * sizeof(double), name, -1, life);
+    *V = *U + 1;
+    *W = *U + 2;
+  } else {
+    *U = arena(d, size * sizeof(double), name, 0, life);
+    *V = arena(d, size * sizeof(double), name, 1, life);
+    *W = arena(d, size * sizeof(double), name, 2, life);
+  }
+}
+static void complex3(struct dns *d, long size, fftw_complex **U,
+                     fftw_complex **V, fftw_complex **W, const char *name,
+                     const char *life) {
+  if (d->s == 3) {
+    *U = arena(d, 3 * size * sizeof(fftw_complex), name, -1, life);
+    *V = *U + 1;
+    *W = *U + 2;
+  } else {
+    *U = arena(d, size * sizeof(fftw_complex), name, 0, life);
+    *V = arena(d, size * sizeof(fftw_complex), name, 1, life);
+    *W = arena(d, size * sizeof(fftw_complex), name, 2, life);
+  }
+}
+static void fields(struct dns *d, int pressure) {
+  long n3, n3f;
+  n3 = d->nx * d->ny * d->nz;
+  n3f = d->nx * d->ny * d->nf;
+  d->arena_used = 0;
+  real3(d, d->nx * d->ny * d->ld, &d->U, &d->V, &d->W, "U", "stage");
+  complex3(d, n3f, &d->U_hat, &d->V_hat, &d->W_hat, "U_hat", "run");
+  complex3(d, n3f, &d->U_hat0, &d->V_hat0, &d->W_hat0, "U_hat0",
+           d->ab2 ? "run" : "step");
+  complex3(d, n3f, &d->U_hat1, &d->V_hat1, &d->W_hat1, "U_hat1", "step");
+  complex3(d, n3f, &d->curlX, &d->curlY, &d->curlZ, "curl", "stage");
+  d->P_hat =
+      pressure ? arena(d, n3f * sizeof(fftw_complex), "P_hat", -1, "run")
+               : NULL;
+  if (d->min) {
+    /* the curl, its physical image, the nonlinear term and its transform
+       share one set of buffers */
+    d->CU = d->U_tmp = (double *)d->curlX;
+    d->CV = d->V_tmp = (double *)d->curlY;
+    d->CW = d->W_tmp = (double *)d->curlZ;
+    d->dU = d->curlX;
+    d->dV = d->curlY;
+    d->dW = d->curlZ;
+  } else {
+    real3(d, n3, &d->U_tmp, &d->V_tmp, &d->W_tmp, "U_tmp", "stage");
+    real3(d, n3, &d->CU, &d->CV, &d->CW, "CU", "stage");
+    complex3(d, n3f, &d->dU, &d->dV, &d->dW, "dU", "stage");
+    d->dump = pressure ? arena(d, n3 * sizeof(double), "dump", -1, "output")
+                       : NULL;
+    d->dump_hat = pressure && d->s == 3
+                      ? arena(d, n3f * sizeof(fftw_complex), "dump_hat", -1,
+                              "output")
+                      : NULL;
+  }
+}
+/* Map the arena on explicit huge pages of hugepage bytes or, with
+   hugepage = 0 or none reserved, on normal pages advised as
+   transparent huge pages. The mapping is aligned to 2 MB. With ooc set
+   it is a shared mapping of a file in that directory instead, removed
+   as soon as it is open. */
+static int arena_map(struct dns *d, long hugepage, const char *ooc) {
+  const size_t align = 1 << 21;
+  char *p, path[FILENAME_MAX];
+  size_t head;
+  d->arena_size = d->arena_used;
+  if (ooc != NULL) {
+    snprintf(path, sizeof path, "%s/dns.XXXXXX", ooc);
+    if ((d->fd = mkstemp(path)) < 0) {
+      fprintf(stderr, "dns: error: fail to create '%s'\n", path);
+      return -1;
+    }
+    unlink(path);
+    d->arena_map = (d->arena_size + align - 1) / align * align;
+    if (ftruncate(d->fd, d->arena_map) != 0) {
+      fprintf(stderr, "dns: error: fail to resize '%s' to %zu bytes\n", path,
+              d->arena_map);
+      return -1;
+    }
+    p = mmap(NULL, d->arena_map, PROT_READ | PROT_WRITE, MAP_SHARED, d->fd, 0);
+    if (p == MAP_FAILED) {
+      fprintf(stderr, "dns: error: fail to map '%s'\n", path);
+      return -1;
+    }
+    d->arena = p;
+    d->behind = d->arena_map > (size_t)sysconf(_SC_PHYS_PAGES) *
+                                   sysconf(_SC_PAGESIZE);
+    if (d->verbose)
+      fprintf(stderr, "dns: arena: %zu bytes in '%s'%s\n", d->arena_size,
+              path, d->behind ? ", write-behind" : "");
+    return 0;
+  }
+  p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (hugepage > 0) {
+    d->arena_map = (d->arena_size + hugepage - 1) / hugepage * hugepage;
+    p = mmap(NULL, d->arena_map, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                 (hugepage == 1L << 30 ? 30 : 21) << MAP_HUGE_SHIFT,
+             -1, 0);
+    if (p == MAP_FAILED)
+      fprintf(stderr,
+              "dns: warning: no huge pages of %ld bytes, using madvise\n",
+              hugepage);
+  }
+#endif
+  if (p == MAP_FAILED) {
+    d->arena_map = (d->arena_size + align - 1) / align * align;
+    p = mmap(NULL, d->arena_map + align, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      fprintf(stderr, "dns: error: fail to map %zu bytes\n", d->arena_map);
+      return -1;
+    }
+    head = (align - (uintptr_t)p % align) % align;
+    if (head > 0)
+      munmap(p, head);
+    munmap(p + head + d->arena_map, align - head);
+    p += head;
+#ifdef MADV_HUGEPAGE
+    madvise(p, d->arena_map, MADV_HUGEPAGE);
+#endif
+  }
+  d->arena = p;
+  if (d->verbose)
+    fprintf(stderr, "dns: arena: %zu bytes in %zu mapped\n", d->arena_size,
+            d->arena_map);
+  return 0;
+}
+/* Size of the arena in bytes. The default mode keeps nine real and
+   fifteen complex arrays (plus two for the pressure); the minimal mode
+   keeps fifteen complex arrays and reuses them for physical fields
+   through in-place transforms (plus P_hat). */
+double dns_memory(long nx, long ny, long nz, int min, int interleave,
+                  int pressure) {
+  struct dns d;
+  memset(&d, 0, sizeof d);
+  d.nx = nx;
+  d.ny = ny;
+  d.nz = nz;
+  d.nf = nz / 2 + 1;
+  d.s = interleave ? 3 : 1;
+  d.min = min;
+  d.ld = min ? 2 * d.nf : nz;
+  fields(&d, pressure);
+  return d.arena_used;
+}
+/* Built-in initial conditions (dns_ic). The flows are written in the
+   coordinates x = 2 pi X / Lx, y = 2 pi Y / Ly, z = 2 pi Z / Lz:
+
+     tgv      Taylor-Green vortex
+              u = sin x cos y cos z, v = -cos x sin y cos z, w = 0
+     kp       Kida-Pelz flow
+              u = sin x (cos 3y cos z - cos y cos 3z) and cyclic
+     abc      Arnold-Beltrami-Childress flow with A = B = C = 1
+              u = sin z + cos y, v = sin x + cos z, w = sin y + cos x
+     random   isotropic field with the spectrum
+              E(k) = 16 sqrt(2 / pi) u0^2 k^4 / k0^5 exp(-2 k^2 / k0^2)
+
+   The analytic flows are evaluated pointwise from tables of sin and cos
+   of each axis. The random field is set in spectral space: each mode has
+   the amplitude of its shell and a random divergence-free direction and
+   phase drawn from a hash of the seed and the integer wavevector, so it
+   does not depend on the number of threads or on the grid size. Modes
+   beyond the dealiasing cut-off are zero. */
+enum { ic_tgv, ic_kp, ic_abc, ic_random };
+struct ic {
+  struct dns *d;
+  int type;
+  double *x, *y, *z; /* sin t, cos t, sin 3t, cos 3t of every point */
+  double k0, u0;
+  uint64_t seed;
+};
+static void ic_table(long n, double *t) {
+  long i;
+  double x;
+  for (i = 0; i < n; i++) {
+    x = (2 * pi / n) * i;
+    t[4 * i] = sin(x);
+    t[4 * i + 1] = cos(x);
+    t[4 * i + 2] = sin(3 * x);
+    t[4 * i + 3] = cos(3 * x);
+  }
+}
+static void k_ic(void *arg, long lo, long hi, int id) {
+  struct ic *ic;
+  struct dns *d;
+  long k, m;
+  double *x, *y, *z, u, v, w;
+  (void)id;
+  ic = arg;
+  d = ic->d;
+  for (; lo < hi; lo++) {
+    x = ic->x + 4 * (lo / d->ny);
+    y = ic->y + 4 * (lo % d->ny);
+    for (k = 0; k < d->nz; k++) {
+      z = ic->z + 4 * k;
+      switch (ic->type) {
+      case ic_tgv:
+        u = x[0] * y[1] * z[1];
+        v = -x[1] * y[0] * z[1];
+        w = 0;
+        break;
+      case ic_kp:
+        u = x[0] * (y[3] * z[1] - y[1] * z[3]);
+        v = y[0] * (z[3] * x[1] - z[1] * x[3]);
+        w = z[0] * (x[3] * y[1] - x[1] * y[3]);
+        break;
+      default:
+        u = z[0] + y[1];
+        v = x[0] + z[1];
+        w = y[0] + x[1];
+        break;
+      }
+      m = (lo * d->ld + k) * d->s;
+      d->U[m] = u;
+      d->V[m] = v;
+      d->W[m] = w;
+    }
+  }
+}
+static void k_ic_random(void *arg, long lo, long hi, int id) {
+  struct ic *ic;
+  struct dns *d;
+  long i, j, k, l, m, ix, iy, iz;
+  int c, mirror;
+  double kv[3], e1[3], e2[3], kk, kh, kn, E, amp, th1, th2, phi;
+  fftw_complex A, B, u[3];
+  uint64_t h;
+  (void)id;
+  ic = arg;
+  d = ic->d;
+  for (; lo < hi; lo++) {
+    i = lo / d->ny;
+    j = lo % d->ny;
+    for (k = 0; k < d->nf; k++) {
+      l = lo * d->nf + k;
+      m = l * d->s;
+      kv[0] = d->kx[i];
+      kv[1] = d->ky[j];
+      kv[2] = d->kz[k];
+      ix = i < (d->nx + 1) / 2 ? i : i - d->nx;
+      iy = j < (d->ny + 1) / 2 ? j : j - d->ny;
+      iz = k;
+      kk = kv[0] * kv[0] + kv[1] * kv[1] + kv[2] * kv[2];
+      u[0] = u[1] = u[2] = 0;
+      if (kk > 0 && fabs(kv[0]) < d->kxmax && fabs(kv[1]) < d->kymax &&
+          fabs(kv[2]) < d->kzmax) {
+        /* in the plane kz = 0 the modes -k and k are the same draw */
+        mirror = iz == 0 && (iy < 0 || (iy == 0 && ix < 0));
+        if (mirror) {
+          ix = -ix;
+          iy = -iy;
+          for (c = 0; c < 3; c++)
+            kv[c] = -kv[c];
+        }
+        h = splitmix(ic->seed ^
+                     splitmix(((uint64_t)ix << 42) ^ ((uint64_t)iy << 21) ^
+                              (uint64_t)iz));
+        th1 = 2 * pi * uniform(&h);
+        th2 = 2 * pi * uniform(&h);
+        phi = 2 * pi * uniform(&h);
+        kn = sqrt(kk);
+        kh = sqrt(kv[0] * kv[0] + kv[1] * kv[1]);
+        if (kh > 0) {
+          e1[0] = kv[1] / kh;
+          e1[1] = -kv[0] / kh;
+          e1[2] = 0;
+          e2[0] = kv[0] * kv[2] / (kn * kh);
+          e2[1] = kv[1] * kv[2] / (kn * kh);
+          e2[2] = -kh / kn;
+        } else {
+          e1[0] = e2[1] = 1;
+          e1[1] = e1[2] = e2[0] = e2[2] = 0;
+        }
+        /* half the squared Fourier coefficient is the shell energy over
+           the number of modes in the shell */
+        E = 16 * sqrt(2 / pi) * ic->u0 * ic->u0 * pow(kn, 4) /
+            pow(ic->k0, 5) * exp(-2 * kk / (ic->k0 * ic->k0));
+        amp = sqrt(2 * E / (4 * pi * kk) * (2 * pi / d->Lx) *
+                   (2 * pi / d->Ly) * (2 * pi / d->Lz)) /
+              d->invN;
+        A = amp * cos(phi) * cexp(I * th1);
+        B = amp * sin(phi) * cexp(I * th2);
+        for (c = 0; c < 3; c++)
+          u[c] = A * e1[c] + B * e2[c];
+        if (mirror)
+          for (c = 0; c < 3; c++)
+            u[c] = conj(u[c]);
+      }
+      d->U_hat[m] = u[0];
+      d->V_hat[m] = u[1];
+      d->W_hat[m] = u[2];
+    }
+  }
+}
+/* Remove the divergence of the velocity */
+static void k_solenoidal(void *arg, long lo, long hi, int id) {
+  struct dns *d;
+  long i, j, k, m;
+  double kk;
+  fftw_complex P;
+  (void)id;
+  d = arg;
+  for (; lo < hi; lo++) {
+    i = lo / d->ny;
+    j = lo % d->ny;
+    for (k = 0; k < d->nf; k++) {
+      m = (lo * d->nf + k) * d->s;
+      kk = d->kx[i] * d->kx[i] + d->ky[j] * d->ky[j] + d->kz[k] * d->kz[k];
+      if (kk == 0)
+        continue;
+      P = (d->kx[i] * d->U_hat[m] + d->ky[j] * d->V_hat[m] +
+           d->kz[k] * d->W_hat[m]) /
+          kk;
+      d->U_hat[m] -= P * d->kx[i];
+      d->V_hat[m] -= P * d->ky[j];
+      d->W_hat[m] -= P * d->kz[k];
+    }
+  }
+}
+/* The FFTW plans of the mode with nthreads threads; the previous ones
+   are destroyed */
+static void plans(struct dns *d, const struct dns_param *p, int nthreads) {
+  long nx, ny, nz, nf;
+  int id;
+  nx = d->nx;
+  ny = d->ny;
+  nz = d->nz;
+  nf = d->nf;
+  if (d->fplan != NULL) {
+    fftw_destroy_plan(d->fplan);
+    fftw_destroy_plan(d->bplan);
+  }
+  if (d->dplan != NULL && d->dplan != d->bplan)
+    fftw_destroy_plan(d->dplan);
+  for (id = 0; id < 4; id++)
+    if (d->xplan[id] != NULL)
+      fftw_destroy_plan(d->xplan[id]);
+  d->fplan = d->bplan = d->dplan = NULL;
+  memset(d->xplan, 0, sizeof d->xplan);
+#ifdef _OPENMP
+  fftw_plan_with_nthreads(nthreads);
+#else
+  (void)nthreads;
+#endif
+  if (p->ooc != NULL) {
+    int n2[] = {ny, nz}, real2[] = {ny, d->ld}, hat2[] = {ny, nf}, n1[] = {nx};
+    unsigned flags;
+    double *real;
+    fftw_complex *hat;
+    long cols, rest;
+    /* planes of odd size are not aligned for SIMD */
+    flags = FFTW_ESTIMATE | (ny * d->ld % 2 ? FFTW_UNALIGNED : 0);
+    real = p->min ? d->CU : d->U;
+    hat = p->min ? d->curlX : d->U_hat;
+    d->fplan = fftw_plan_many_dft_r2c(2, n2, 1, real, real2, 1, 0, hat, hat2,
+                                      1, 0, flags | FFTW_PRESERVE_INPUT);
+    d->bplan = fftw_plan_many_dft_c2r(2, n2, 1, hat, hat2, 1, 0, real, real2,
+                                      1, 0, flags);
+    d->dplan = d->bplan;
+    /* a block of columns is about the size of a plane, in runs of whole
+       pages */
+    cols = ny * nf;
+    d->block = (cols + nx - 1) / nx;
+    d->block = (d->block + 255) / 256 * 256;
+    if (d->block > cols)
+      d->block = cols;
+    rest = cols % d->block;
+    d->xplan[0] = fftw_plan_many_dft(1, n1, d->block, hat, NULL, cols, 1, hat,
+                                     NULL, cols, 1, FFTW_FORWARD,
+                                     FFTW_ESTIMATE);
+    d->xplan[1] = fftw_plan_many_dft(1, n1, d->block, hat, NULL, cols, 1, hat,
+                                     NULL, cols, 1, FFTW_BACKWARD,
+                                     FFTW_ESTIMATE);
+    if (rest > 0) {
+      d->xplan[2] = fftw_plan_many_dft(1, n1, rest, hat, NULL, cols, 1, hat,
+                                       NULL, cols, 1, FFTW_FORWARD,
+                                       FFTW_ESTIMATE);
+      d->xplan[3] = fftw_plan_many_dft(1, n1, rest, hat, NULL, cols, 1, hat,
+                                       NULL, cols, 1, FFTW_BACKWARD,
+                                       FFTW_ESTIMATE);
+    }
+    if (p->verbose && d->fft == 0)
+      fprintf(stderr, "dns: out-of-core: %ld planes, %ld blocks of %ld\n", nx,
+              (cols + d->block - 1) / d->block, d->block);
+  } else if (p->min) {
+    d->fplan = fftw_plan_dft_r2c_3d(nx, ny, nz, d->CU, d->curlX, FFTW_ESTIMATE);
+    d->bplan = fftw_plan_dft_c2r_3d(nx, ny, nz, d->curlX, d->CU, FFTW_ESTIMATE);
+    d->dplan = d->bplan;
+  } else {
+    if (p->interleave) {
+      int nn[] = {nx, ny, nz};
+      d->fplan = fftw_plan_many_dft_r2c(3, nn, 3, d->U, NULL, 3, 1, d->U_hat,
+                                        NULL, 3, 1,
+                                        FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+      d->bplan = fftw_plan_many_dft_c2r(3, nn, 3, d->U_hat, NULL, 3, 1, d->U,
+                                        NULL, 3, 1, FFTW_ESTIMATE);
+      if (p->pressure)
+        d->dplan = fftw_plan_dft_c2r_3d(nx, ny, nz, d->dump_hat, d->dump,
+                                        FFTW_ESTIMATE);
+    } else {
+      d->fplan = fftw_plan_dft_r2c_3d(nx, ny, nz, d->U, d->U_hat,
+                                      FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+      d->bplan = fftw_plan_dft_c2r_3d(nx, ny, nz, d->U_hat, d->U,
+                                      FFTW_ESTIMATE);
+      d->dplan = d->bplan;
+    }
+  }
+#ifdef _OPENMP
+  fftw_plan_with_nthreads(pool.nthreads);
+#endif
+  d->fft = nthreads;
+}
+/* Autotuning (dns_param.tune). The file has a line per host, grid,
+   mode, thread count and kernels with the best configuration found for
+   them: the pinning of the team, the threads of the FFT plans and the
+   team size of each phase of the step. A run finding its line applies
+   it. Otherwise it measures, on the zero fields before the start, the
+   FFTs (a backward and a forward vector transform) with 1, 2, 4, ...
+   and all threads, each phase with the same team sizes and, with more
+   than one thread, a whole sequence of them unpinned and pinned, takes
+   the fastest of three repetitions and appends the line. The results do
+   not depend on the choices. */
+static const char *phase_names[] = {"copy", "curl", "cross", "project",
+                                    "update"};
+/* Run phase (phase_n for the FFTs, -1 for all) and return its best time
+   of three */
+static double tune_time(struct dns *d, int phase) {
+  double best, t;
+  long rows;
+  int rep, i;
+  rows = d->nx * d->ny;
+  best = HUGE_VAL;
+  for (rep = 0; rep < 3; rep++) {
+    t = now();
+    for (i = phase < 0 ? 0 : phase; i <= (phase < 0 ? phase_n : phase); i++)
+      switch (i) {
+      case phase_copy:
+        d->src = d->U_hat;
+        d->dst = d->U_hat1;
+        phase_for(d, phase_copy, rows, k_copy, d);
+        break;
+      case phase_curl:
+        phase_for(d, phase_curl, rows, d->kern->curl, d);
+        break;
+      case phase_cross:
+        phase_for(d, phase_cross, rows, k_cross, d);
+        break;
+      case phase_project:
+        phase_for(d, phase_project, rows, d->ab2 ? k_ab2 : d->kern->project,
+                  d);
+        break;
+      case phase_update:
+        d->coef = b[0];
+        phase_for(d, phase_update, rows, d->kern->stage, d);
+        phase_for(d, phase_update, rows, d->kern->accumulate, d);
+        break;
+      case phase_n:
+        if (d->min) {
+          c2r3(d->bplan, d, d->curlX, d->curlY, d->curlZ, d->CU, d->CV, d->CW);
+          r2c3(d->fplan, d, d->CU, d->CV, d->CW, d->curlX, d->curlY,
+               d->curlZ);
+        } else {
+          c2r3(d->bplan, d, d->U_hat, d->V_hat, d->W_hat, d->U, d->V, d->W);
+          r2c3(d->fplan, d, d->U, d->V, d->W, d->U_hat, d->V_hat, d->W_hat);
+        }
+        break;
+      }
+    t = now() - t;
+    if (t < best)
+      best = t;
+  }
+  return best;
+}
+static void tune(struct dns *d, const struct dns_param *p) {
+  FILE *file;
+  char line[1024], host[256], key[512], mode[32];
+  double t, best, start;
+  int n, i, c, pick, team[phase_n + 2];
+  if (gethostname(host, sizeof host) != 0)
+    strcpy(host, "localhost");
+  host[sizeof host - 1] = '\0';
+  snprintf(mode, sizeof mode, "%s%s%s",
+           d->min ? "min" : d->s == 3 ? "interleave" : "default",
+           d->ab2 ? ",ab2cn" : "", p->ooc != NULL ? ",ooc" : "");
+  snprintf(key, sizeof key, "%s %ld %ld %ld %s %d %s", host, d->nx, d->ny,
+           d->nz, mode, pool.nthreads, d->kern->name);
+  n = strlen(key);
+  if ((file = fopen(p->tune, "r")) != NULL) {
+    while (fgets(line, sizeof line, file) != NULL)
+      if (strncmp(line, key, n) == 0 && line[n] == ' ') {
+        c = sscanf(line + n, "%d %d %d %d %d %d %d", &team[0], &team[1],
+                   &team[2], &team[3], &team[4], &team[5], &team[6]);
+        for (i = 0; i < c; i++)
+          if (team[i] < 0 || team[i] > pool.nthreads || (i > 0 && !team[i]))
+            c = 0;
+        if (c == phase_n + 2) {
+          d->pin = team[0];
+          pool_pin(d->pin);
+          if (team[1] != d->fft)
+            plans(d, p, team[1]);
+          for (i = 0; i < phase_n; i++)
+            d->team[i] = team[i + 2];
+          fclose(file);
+          if (d->verbose)
+            fprintf(stderr, "dns: tune: from '%s'\n", p->tune);
+          goto done;
+        }
+      }
+    fclose(file);
+  }
+  start = now();
+  if (pool.nthreads > 1) {
+    t = tune_time(d, -1);
+    pool_pin(1);
+    d->pin = tune_time(d, -1) < t;
+    pool_pin(d->pin);
+  }
+  best = 0;
+  pick = 1;
+  for (c = 1;; c = c * 2 < pool.nthreads ? c * 2 : pool.nthreads) {
+    if (c != d->fft)
+      plans(d, p, c);
+    t = tune_time(d, phase_n);
+    if (c == 1 || t < best) {
+      best = t;
+      pick = c;
+    }
+    if (c == pool.nthreads)
+      break;
+  }
+  if (pick != d->fft)
+    plans(d, p, pick);
+  for (i = 0; i < phase_n; i++) {
+    for (c = 1;; c = c * 2 < pool.nthreads ? c * 2 : pool.nthreads) {
+      d->team[i] = c;
+      t = tune_time(d, i);
+      if (c == 1 || t < best) {
+        best = t;
+        pick = c;
+      }
+      if (c == pool.nthreads)
+        break;
+    }
+    d->team[i] = pick;
+  }
+  if ((file = fopen(p->tune, "a")) == NULL)
+    fprintf(stderr, "dns: warning: fail to write '%s'\n", p->tune);
+  else {
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+      fprintf(file, "# host nx ny nz mode threads kernels pin fft %s %s %s "
+                    "%s %s\n",
+              phase_names[0], phase_names[1], phase_names[2], phase_names[3],
+              phase_names[4]);
+    fprintf(file, "%s %d %d", key, d->pin, d->fft);
+    for (i = 0; i < phase_n; i++)
+      fprintf(file, " %d", d->team[i]);
+    fprintf(file, "\n");
+    fclose(file);
+  }
+  if (d->verbose)
+    fprintf(stderr, "dns: tune: measured in %.2f seconds\n", now() - start);
+done:
+  if (d->verbose) {
+    fprintf(stderr, "dns: tune: pin %d fft %d", d->pin, d->fft);
+    for (i = 0; i < phase_n; i++)
+      fprintf(stderr, " %s %d", phase_names[i], d->team[i]);
+    fprintf(stderr, "\n");
+  }
+}
+/* Status record (dns_param.status), written under a sequence lock */
+static void status_begin(struct dns_status *s) {
+  __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+static void status_end(struct dns_status *s) {
+  __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+/* Resident bytes of the process and dirty bytes of the whole machine */
+static void status_memory(long *rss, long *dirty) {
+  FILE *file;
+  char line[256];
+  long pages, kb;
+  *rss = *dirty = 0;
+  if ((file = fopen("/proc/self/statm", "r")) != NULL) {
+    if (fscanf(file, "%*s %ld", &pages) == 1)
+      *rss = pages * sysconf(_SC_PAGESIZE);
+    fclose(file);
+  }
+  if ((file = fopen("/proc/meminfo", "r")) != NULL) {
+    while (fgets(line, sizeof line, file) != NULL)
+      if (sscanf(line, "Dirty: %ld", &kb) == 1 ||
+          sscanf(line, "Writeback: %ld", &kb) == 1)
+        *dirty += kb * 1024;
+    fclose(file);
+  }
+}
+static void status_open(struct dns *d, const char *dir) {
+  static int count;
+  struct dns_status *s;
+  char path[FILENAME_MAX];
+  int fd;
+  snprintf(path, sizeof path, "%s/dns.%ld.%d", dir, (long)getpid(), count++);
+  s = MAP_FAILED;
+  if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) >= 0 &&
+      ftruncate(fd, sizeof *s) == 0)
+    s = mmap(NULL, sizeof *s, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (fd >= 0)
+    close(fd);
+  if (s == MAP_FAILED) {
+    fprintf(stderr, "dns: warning: fail to create status record '%s'\n",
+            path);
+    if (fd >= 0)
+      unlink(path);
+    return;
+  }
+  status_begin(s);
+  s->pid = getpid();
+  s->nx = d->nx;
+  s->ny = d->ny;
+  s->nz = d->nz;
+  s->nthreads = d->nthreads;
+  s->start = s->update = wall();
+  s->t = d->t;
+  s->dt = d->dt;
+  s->step = s->diag_step = d->tstep;
+  status_memory(&s->rss, &s->dirty);
+  s->magic = dns_status_magic;
+  status_end(s);
+  d->status = s;
+  d->status_path = strdup(path);
+  d->since = now();
+  d->since_step = d->tstep;
+  if (d->verbose)
+    fprintf(stderr, "dns: status: %s\n", path);
+}
+/* After a step. The averages are taken once a second, so the hot loop
+   only reads the clock around the phases. */
+static void status_step(struct dns *d) {
+  struct dns_status *s;
+  double t, busy;
+  long n;
+  int i;
+  s = d->status;
+  t = now();
+  n = d->tstep - d->since_step;
+  status_begin(s);
+  s->step = d->tstep;
+  s->t = d->t;
+  s->update = wall();
+  if (t - d->since >= 1 && n > 0) {
+    s->rate = n / (t - d->since);
+    busy = 0;
+    for (i = 0; i < dns_status_ntime - 1; i++) {
+      s->time[i] = d->clock[i] / n;
+      busy += d->clock[i];
+      d->clock[i] = 0;
+    }
+    s->time[i] = (t - d->since - busy) / n;
+    status_memory(&s->rss, &s->dirty);
+    d->since = t;
+    d->since_step = d->tstep;
+  }
+  status_end(s);
+}
+/* Number of live runs: the thread team and the FFTW threads are set up
+   by the first and torn down by the last, so later runs must ask for
+   the same number of threads or for the default */
+static int instances;
+struct dns *dns_init(const struct dns_param *p) {
+  struct dns *d;
+  const struct kernels *kern;
+  long nx, ny, nz, nf, n3, n3f, rows;
+  int id;
+  if (p->nx < 1 || p->ny < 1 || p->nz < 1) {
+    fprintf(stderr, "dns: error: wrong grid size\n");
+    return NULL;
+  }
+  if (p->Lx <= 0 || p->Ly <= 0 || p->Lz <= 0) {
+    fprintf(stderr, "dns: error: wrong box size\n");
+    return NULL;
+  }
+  if (p->interleave && p->min) {
+    fprintf(stderr, "dns: error: -x and -m cannot be combined\n");
+    return NULL;
+  }
+  if (p->ooc != NULL && (p->interleave || p->hugepage > 0)) {
+    fprintf(stderr, "dns: error: -O cannot be combined with -x or -H\n");
+    return NULL;
+  }
+  if (p->interleave && p->kernels != NULL &&
+      strcmp(p->kernels, "scalar") != 0) {
+    fprintf(stderr, "dns: error: -x needs scalar kernels\n");
+    return NULL;
+  }
+  kern = NULL;
+  for (id = 0; id < (int)(sizeof kernels / sizeof *kernels); id++)
+    if (p->kernels == NULL
+            ? kernels_supported(&kernels[id]) && (!p->interleave || id == 0)
+            : strcmp(kernels[id].name, p->kernels) == 0)
+      kern = &kernels[id];
+  if (kern == NULL) {
+    fprintf(stderr, "dns: error: unknown kernels '%s'\n", p->kernels);
+    return NULL;
+  }
+  if (!kernels_supported(kern)) {
+    fprintf(stderr, "dns: error: kernels '%s' are not supported by the CPU\n",
+            kern->name);
+    return NULL;
+  }
+  if (p->scheme != NULL && strcmp(p->scheme, "rk4") != 0 &&
+      strcmp(p->scheme, "ab2cn") != 0) {
+    fprintf(stderr, "dns: error: unknown scheme '%s'\n", p->scheme);
+    return NULL;
+  }
+  if (instances > 0 && p->nthreads > 0 && p->nthreads != pool.nthreads) {
+    fprintf(stderr,
+            "dns: error: %d threads asked, the live runs use %d\n",
+            p->nthreads, pool.nthreads);
+    return NULL;
+  }
+  if (p->verbose)
+    fprintf(stderr, "dns: kernels: %s\n", kern->name);
+  if (instances++ == 0) {
+#ifdef _OPENMP
+    id = p->nthreads > 0 ? p->nthreads : omp_get_max_threads();
+    fftw_init_threads();
+    fftw_plan_with_nthreads(id);
+    if (p->verbose)
+      fprintf(stderr, "dns: omp_get_max_threads: %d\n", id);
+    fftw_threads_set_callback(parallel_loop, NULL);
+#else
+    id = 1;
+#endif
+    if (pool_init(id) != 0) {
+      instances--;
+#ifdef _OPENMP
+      fftw_cleanup_threads();
+#endif
+      return NULL;
+    }
+  }
+  d = calloc(1, sizeof *d);
+  d->kern = kern;
+  d->nthreads = pool.nthreads;
+  nx = d->nx = p->nx;
+  ny = d->ny = p->ny;
+  nz = d->nz = p->nz;
+  nf = d->nf = nz / 2 + 1;
+  n3 = nx * ny * nz;
+  n3f = nx * ny * nf;
+  rows = nx * ny;
+  d->Lx = p->Lx;
+  d->Ly = p->Ly;
+  d->Lz = p->Lz;
+  d->nu = p->nu;
+  d->dt = p->dt;
+  d->min = p->min;
+  d->verbose = p->verbose;
+  d->ab2 = p->scheme != NULL && strcmp(p->scheme, "ab2cn") == 0;
+  d->s = p->interleave ? 3 : 1;
+  d->ld = p->min ? 2 * nf : nz;
+  d->invN = 1.0 / n3;
+  d->kx = malloc(nx * sizeof(double));
+  d->ky = malloc(ny * sizeof(double));
+  d->kz = malloc(nf * sizeof(double));
+  d->kz2 = malloc(2 * nf * sizeof(double));
+  d->mask2 = malloc(2 * nf * sizeof(double));
+  d->energy = malloc(d->nthreads * sizeof(long double));
+  d->Omega = malloc(d->nthreads * sizeof(long double));
+  d->stats = malloc(9 * d->nthreads * sizeof(double));
+  d->fd = -1;
+  fields(d, p->pressure);
+  if (arena_map(d, p->hugepage, p->ooc) != 0) {
+    dns_destroy(d);
+    return NULL;
+  }
+  fields(d, p->pressure);
+  plans(d, p, pool.nthreads);
+  /* wavenumbers in units of 2 pi / L, the Nyquist mode is negative in x
+     and y and positive in z */
+  for (long i = 0; i < nx; i++)
+    d->kx[i] = (i < (nx + 1) / 2 ? i : i - nx) * (2 * pi / d->Lx);
+  for (long j = 0; j < ny; j++)
+    d->ky[j] = (j < (ny + 1) / 2 ? j : j - ny) * (2 * pi / d->Ly);
+  for (long k = 0; k < nf; k++)
+    d->kz[k] = k * (2 * pi / d->Lz);
+  d->kxmax = 2. / 3. * (nx / 2 + 1) * (2 * pi / d->Lx);
+  d->kymax = 2. / 3. * (ny / 2 + 1) * (2 * pi / d->Ly);
+  d->kzmax = 2. / 3. * (nz / 2 + 1) * (2 * pi / d->Lz);
+  for (long k = 0; k < nf; k++) {
+    d->kz2[2 * k] = d->kz2[2 * k + 1] = d->kz[k];
+    d->mask2[2 * k] = d->mask2[2 * k + 1] = (fabs(d->kz[k]) < d->kzmax) * d->dt;
+  }
+  for (id = 0; id < phase_n; id++)
+    d->team[id] = pool.nthreads;
+  if (p->tune != NULL)
+    tune(d, p);
+  /* the run starts at rest */
+  memset(d->U, 0, d->s * rows * d->ld * sizeof(double));
+  if (d->s == 1) {
+    memset(d->V, 0, rows * d->ld * sizeof(double));
+    memset(d->W, 0, rows * d->ld * sizeof(double));
+  }
+  dns_commit(d);
+  if (d->P_hat != NULL)
+    memset(d->P_hat, 0, n3f * sizeof(fftw_complex));
+  if (p->insitu != NULL && insitu_read(p->insitu, d) != 0) {
+    dns_destroy(d);
+    return NULL;
+  }
+  if (p->status != NULL)
+    status_open(d, p->status);
+  return d;
+}
+/* Transform the physical velocity to the spectral one; the in-place
+   plans of the minimal mode destroy the input and transform copies */
+void dns_commit(struct dns *d) {
+  long n3f;
+  int c;
+  if (d->min) {
+    n3f = d->nx * d->ny * d->nf;
+    for (c = 0; c < 3; c++) {
+      memcpy(d->CU, field(d, c), d->nx * d->ny * d->ld * sizeof(double));
+      fft_r2c(d->fplan, d, d->CU, d->curlX);
+      memcpy(c == 0 ? d->U_hat : c == 1 ? d->V_hat : d->W_hat, d->curlX,
+             n3f * sizeof(fftw_complex));
+    }
+  } else
+    r2c3(d->fplan, d, d->U, d->V, d->W, d->U_hat, d->V_hat, d->W_hat);
+  d->fresh = 1;
+  d->history = 0;
+}
+int dns_ic(struct dns *d, const char *name, double k0, double u0,
+           unsigned long seed) {
+  static const char *names[] = {"tgv", "kp", "abc", "random"};
+  struct ic ic;
+  long rows;
+  rows = d->nx * d->ny;
+  for (ic.type = 0; ic.type < (int)(sizeof names / sizeof *names); ic.type++)
+    if (strcmp(name, names[ic.type]) == 0)
+      break;
+  if (ic.type == sizeof names / sizeof *names) {
+    fprintf(stderr, "dns: error: unknown initial condition '%s'\n", name);
+    return -1;
+  }
+  if (ic.type == ic_random && (k0 <= 0 || u0 < 0)) {
+    fprintf(stderr, "dns: error: wrong spectrum parameters\n");
+    return -1;
+  }
+  ic.d = d;
+  ic.k0 = k0;
+  ic.u0 = u0;
+  ic.seed = seed;
+  if (ic.type == ic_random) {
+    pool_for(rows, k_ic_random, &ic);
+    d->fresh = 0;
+    d->history = 0;
+  } else {
+    ic.x = malloc(4 * d->nx * sizeof(double));
+    ic.y = malloc(4 * d->ny * sizeof(double));
+    ic.z = malloc(4 * d->nz * sizeof(double));
+    ic_table(d->nx, ic.x);
+    ic_table(d->ny, ic.y);
+    ic_table(d->nz, ic.z);
+    pool_for(rows, k_ic, &ic);
+    free(ic.x);
+    free(ic.y);
+    free(ic.z);
+    dns_commit(d);
+    /* the flows are divergence-free only in a box with equal sides */
+    if (d->Lx != d->Ly || d->Ly != d->Lz) {
+      pool_for(rows, k_solenoidal, d);
+      d->fresh = 0;
+    }
+  }
+  if (d->P_hat != NULL)
+    memset(d->P_hat, 0, rows * d->nf * sizeof(fftw_complex));
+  return 0;
+}
+double *dns_field(struct dns *d, int var, long stride[3]) {
+  fftw_complex *work;
+  long rows;
+  int c;
+  rows = d->nx * d->ny;
+  if (var == dns_P) {
+    if (d->P_hat == NULL)
+      return NULL;
+    if (d->min)
+      d->real = d->CU;
+    else
+      d->real = d->dump;
+    if (d->s == 3) {
+      d->src = d->P_hat;
+      d->dst = d->dump_hat;
+      d->gs = 1;
+      pool_for(rows, k_gather, d);
+      fftw_execute_dft_c2r(d->dplan, d->dump_hat, d->dump);
+    } else
+      c2r(d->bplan, d, d->P_hat, d->real, d->min ? NULL : d->curlX);
+    d->gs = 1;
+    pool_for(rows, k_scale, d);
+    stride[0] = d->ny * d->ld;
+    stride[1] = d->ld;
+    stride[2] = 1;
+    return d->real;
+  }
+  if (var < dns_U || var > dns_W)
+    return NULL;
+  if (!d->fresh) {
+    work = d->min ? NULL : d->curlX;
+    c2r(d->bplan, d, d->U_hat, d->U, work);
+    if (d->s == 1) {
+      c2r(d->bplan, d, d->V_hat, d->V, work);
+      c2r(d->bplan, d, d->W_hat, d->W, work);
+    }
+    d->gs = d->s;
+    for (c = 0; c < 3; c++) {
+      d->real = field(d, c);
+      pool_for(rows, k_scale, d);
+    }
+    d->fresh = 1;
+  }
+  stride[0] = d->ny * d->ld * d->s;
+  stride[1] = d->ld * d->s;
+  stride[2] = d->s;
+  return field(d, var);
+}
+/* The transform of u x curl(u) of U_hat in dU. stage is the stage of
+   the time step, which advances the tracers, or -1; the in-situ output
+   samples the physical fields of stage 0. */
+static void nonlinear(struct dns *d, int stage) {
+  fftw_complex *work;
+  long rows;
+  int id;
+  rows = d->nx * d->ny;
+  work = d->min ? NULL : d->curlX; /* c2r work space */
+  c2r(d->bplan, d, d->U_hat, d->U, work);
+  if (d->s == 1) {
+    c2r(d->bplan, d, d->V_hat, d->V, work);
+    c2r(d->bplan, d, d->W_hat, d->W, work);
+  }
+  phase_for(d, phase_curl, rows, d->kern->curl, d);
+  c2r3(d->bplan, d, d->curlX, d->curlY, d->curlZ, d->CU, d->CV, d->CW);
+  phase_for(d, phase_cross, rows, k_cross, d);
+  if (d->tr != NULL && stage >= 0)
+    tracers_stage(d->tr, stage, stage == 0 && d->tstep % d->tr->every == 0);
+  if (stage == 0)
+    for (id = 0; id < d->nq; id++)
+      if (d->tstep % d->q[id].every == 0)
+        insitu_write(d, &d->q[id], d->nthreads, d->tstep, d->t);
+  r2c3(d->fplan, d, d->U_tmp, d->V_tmp, d->W_tmp, d->dU, d->dV, d->dW);
+}
+static void swap(fftw_complex **x, fftw_complex **y) {
+  fftw_complex *t;
+  t = *x;
+  *x = *y;
+  *y = t;
+}
+/* The multistep scheme starts with a Runge-Kutta step. Its U_hat0 is the
+   velocity of the previous step, whose nonlinear term is evaluated once
+   in place to fill the history. */
+void dns_step(struct dns *d, long nsteps) {
+  const struct kernels *kern;
+  long rows;
+  int rk;
+  kern = d->kern;
+  rows = d->nx * d->ny;
+  for (; nsteps > 0; nsteps--) {
+    if (d->ab2 && d->history > 0) {
+      if (d->history == 1) {
+        swap(&d->U_hat, &d->U_hat0);
+        swap(&d->V_hat, &d->V_hat0);
+        swap(&d->W_hat, &d->W_hat0);
+        nonlinear(d, -1);
+        phase_for(d, phase_project, rows, k_ab2, d);
+        swap(&d->U_hat, &d->U_hat0);
+        swap(&d->V_hat, &d->V_hat0);
+        swap(&d->W_hat, &d->W_hat0);
+        d->history = 2;
+      }
+      nonlinear(d, 0);
+      phase_for(d, phase_project, rows, k_ab2, d);
+      d->t += d->dt;
+      d->tstep++;
+      d->fresh = 0;
+      if (d->status != NULL)
+        status_step(d);
+      continue;
+    }
+    phase_for(d, phase_copy, rows, k_start, d);
+    for (rk = 0; rk < 4; rk++) {
+      nonlinear(d, rk);
+      phase_for(d, phase_project, rows, kern->project, d);
+      if (rk < 3) {
+        d->coef = b[rk];
+        phase_for(d, phase_update, rows, kern->stage, d);
+      }
+      d->coef = a[rk];
+      phase_for(d, phase_update, rows, kern->accumulate, d);
+    }
+    phase_for(d, phase_copy, rows, k_finish, d);
+    d->t += d->dt;
+    d->tstep++;
+    d->fresh = 0;
+    d->history = 1;
+    if (d->status != NULL)
+      status_step(d);
+  }
+}
+/* The energy and the enstrophy are sums over the stored half of the
+   spectrum. A member with no rows (fewer rows than threads) leaves its
+   partial sums untouched, so they are cleared first. */
+void dns_diag(struct dns *d, struct dns_diag *diag) {
+  int id;
+  for (id = 0; id < d->nthreads; id++)
+    d->energy[id] = d->Omega[id] = 0.0;
+  pool_for(d->nx * d->ny, k_energy, d);
+  diag->step = d->tstep;
+  diag->t = d->t;
+  diag->energy = 0.0;
+  diag->enstrophy = 0.0;
+  for (id = 0; id < d->nthreads; id++) {
+    diag->energy += d->energy[id];
+    diag->enstrophy += d->Omega[id];
+  }
+  diag->energy *= d->invN * d->invN;
+  diag->enstrophy *= d->invN * d->invN;
+  if (d->status != NULL) {
+    status_begin(d->status);
+    d->status->energy = diag->energy;
+    d->status->diag_step = d->tstep;
+    status_end(d->status);
+  }
+}
+void dns_destroy(struct dns *d) {
+  int id;
+  if (d->fplan != NULL) {
+    fftw_destroy_plan(d->fplan);
+    fftw_destroy_plan(d->bplan);
+  }
+  if (d->dplan != NULL && d->dplan != d->bplan)
+    fftw_destroy_plan(d->dplan);
+  for (id = 0; id < 4; id++)
+    if (d->xplan[id] != NULL)
+      fftw_destroy_plan(d->xplan[id]);
+  if (d->arena != NULL)
+    munmap(d->arena, d->arena_map);
+  if (d->fd >= 0)
+    close(d->fd);
+  if (d->status != NULL) {
+    munmap(d->status, sizeof *d->status);
+    unlink(d->status_path);
+    free(d->status_path);
+  }
+  free(d->kx);
+  free(d->ky);
+  free(d->kz);
+  free(d->kz2);
+  free(d->mask2);
+  for (id = 0; id < d->nq; id++) {
+    fclose(d->q[id].file);
+    free(d->q[id].buf);
+  }
+  free(d->q);
+  if (d->tr != NULL)
+    tracers_free(d->tr);
+  free(d->stats);
+  free(d->energy);
+  free(d->Omega);
+  free(d);
+  if (--instances == 0) {
+#ifdef _OPENMP
+    fftw_cleanup_threads();
+#endif
+    pool_fini();
+  }
+}
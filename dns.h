@@ -0,0 +1,99 @@
+/* Pseudo-spectral solver of the incompressible Navier-Stokes equations
+   in a periodic box. A run is a struct dns created by dns_init from a
+   struct dns_param; on a wrong parameter or an unreadable in-situ file
+   it prints the error to stderr and returns NULL. The velocity is set
+   through the pointers returned by dns_field and transformed with
+   dns_commit; dns_step advances the run and dns_diag reports the energy
+   and the enstrophy.
+
+   dns_field returns the physical field var (dns_U, dns_V, dns_W or
+   dns_P) and its strides in elements: point (i, j, k) of the nx * ny *
+   nz grid is at stride[0] * i + stride[1] * j + stride[2] * k. The
+   array belongs to the run and stays valid until the next call of
+   dns_step or dns_destroy; the pressure is available when pressure is
+   set in the parameters. Writes to the velocity arrays take effect with
+   dns_commit.
+
+   dns_ic sets a built-in initial velocity: "tgv" (Taylor-Green), "kp"
+   (Kida-Pelz), "abc" (Arnold-Beltrami-Childress) or "random", an
+   isotropic field with a spectrum peaked at k0, RMS velocity u0 per
+   component and the given seed. k0, u0 and seed are used by "random"
+   only. It returns 0 or -1 for an unknown name.
+
+   The time step is the classical fourth order Runge-Kutta scheme or,
+   with scheme "ab2cn", second order Adams-Bashforth for the nonlinear
+   term and Crank-Nicolson for the viscous one: one evaluation of the
+   nonlinear term per step instead of four. Its first step after
+   dns_init, dns_commit or dns_ic is a Runge-Kutta step.
+
+   The fields are one arena of dns_memory bytes on huge pages of
+   hugepage bytes or, with hugepage = 0 or none reserved, on transparent
+   huge pages. With ooc set the arena is a file in that directory and
+   the transforms stream over it by slabs, for grids larger than the
+   RAM.
+
+   With tune set dns_init looks up the pinning, the FFT threads and the
+   team size of each phase of the step for this host, grid and mode in
+   that file, or measures them and appends them to it.
+
+   With status set the run publishes a struct dns_status in the file
+   dns.<pid>.<n> of that directory (/dev/shm), updated after every step
+   and removed by dns_destroy. seq is odd while the run writes the
+   record: a reader takes a copy between two equal even values of seq.
+   rate is the steps per second and time the seconds per step of the
+   FFTs, of the phases copy, curl, cross, project and update and of the
+   rest, averaged over about a second; rss is the resident memory of the
+   process and dirty the bytes of the whole machine waiting for
+   writeback (Dirty and Writeback of /proc/meminfo), not of this run
+   alone, both sampled with them. energy is that of the last dns_diag, at
+   diag_step.
+
+   All runs of a process share one thread team, started by the first
+   dns_init with nthreads threads and stopped by the last dns_destroy.
+   dns_init fails if another run is live and nthreads is neither 0 nor
+   its number of threads. The team, its pinning (set by the last tuned
+   run) and the team size of a phase are process state: the functions
+   of dns.h must not be called for two runs at the same time, e.g.,
+   from two threads. */
+
+struct dns;
+struct dns_param {
+  long nx, ny, nz;       /* grid size, z is the fastest index */
+  double Lx, Ly, Lz;     /* box lengths */
+  double nu, dt;         /* viscosity and time step */
+  int min;               /* memory-minimal mode */
+  int interleave;        /* interleaved vector-field layout */
+  int pressure;          /* keep the pressure for dns_field */
+  int nthreads;          /* 0 for omp_get_max_threads() */
+  int verbose;           /* report the choices on stderr */
+  const char *kernels;   /* "scalar", "avx2", "avx512" or NULL */
+  const char *insitu;    /* in-situ output requests or NULL */
+  const char *scheme;    /* "rk4" (NULL) or "ab2cn" */
+  long hugepage;         /* 2M or 1G explicit huge pages, 0 for THP */
+  const char *ooc;       /* out-of-core directory or NULL */
+  const char *tune;      /* autotuning file or NULL */
+  const char *status;    /* status record directory or NULL */
+};
+struct dns_diag {
+  long step;
+  double t;
+  long double energy, enstrophy;
+};
+enum { dns_U, dns_V, dns_W, dns_P };
+enum { dns_status_magic = 0x646e7331, dns_status_ntime = 7 };
+struct dns_status {
+  unsigned long magic, seq;
+  long pid, nx, ny, nz, nthreads, step, diag_step, rss, dirty;
+  double start, update, t, dt, energy, rate, time[dns_status_ntime];
+};
+
+struct dns *dns_init(const struct dns_param *);
+double *dns_field(struct dns *, int var, long stride[3]);
+void dns_commit(struct dns *);
+int dns_ic(struct dns *, const char *name, double k0, double u0,
+           unsigned long seed);
+void dns_step(struct dns *, long nsteps);
+void dns_diag(struct dns *, struct dns_diag *);
+void dns_destroy(struct dns *);
+double dns_memory(long nx, long ny, long nz, int min, int interleave,
+                  int pressure);
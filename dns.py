@@ -0,0 +1,195 @@
+"""Python binding of libdns.so (dns.h)
+
+The fields are NumPy views of the solver's arrays, no data is copied:
+
+    import dns
+    import numpy as np
+    d = dns.Dns(64, 64, 64, nu=0.01, dt=0.01)
+    x = np.arange(64) * 2 * np.pi / 64
+    U, V, W = d.field("U"), d.field("V"), d.field("W")
+    np.einsum('i,j,k', np.sin(x), np.cos(x), np.cos(x), out=U)
+    np.einsum('i,j,k', -np.cos(x), np.sin(x), np.cos(x), out=V)
+    W.fill(0)
+    d.commit()
+    d.step(10)
+    print(d.diag())
+
+A view is valid until the next step() and must be fetched again with
+field() after it. A view keeps its run alive, and close() frees the run
+once no view is left; any other call after close() raises ValueError.
+The runs of a process share the solver's threads: later runs take the
+nthreads of the first one (or 0), and two runs must not be used from
+two Python threads at the same time. libdns.so is looked up next to
+this file, then by the name in DNS_LIB or on the library path.
+"""
+import ctypes
+import math
+import os
+import weakref
+import numpy as np
+
+_c_double_p = ctypes.POINTER(ctypes.c_double)
+
+
+class _Param(ctypes.Structure):
+    _fields_ = [
+        ("nx", ctypes.c_long),
+        ("ny", ctypes.c_long),
+        ("nz", ctypes.c_long),
+        ("Lx", ctypes.c_double),
+        ("Ly", ctypes.c_double),
+        ("Lz", ctypes.c_double),
+        ("nu", ctypes.c_double),
+        ("dt", ctypes.c_double),
+        ("min", ctypes.c_int),
+        ("interleave", ctypes.c_int),
+        ("pressure", ctypes.c_int),
+        ("nthreads", ctypes.c_int),
+        ("verbose", ctypes.c_int),
+        ("kernels", ctypes.c_char_p),
+        ("insitu", ctypes.c_char_p),
+        ("scheme", ctypes.c_char_p),
+        ("hugepage", ctypes.c_long),
+        ("ooc", ctypes.c_char_p),
+        ("tune", ctypes.c_char_p),
+        ("status", ctypes.c_char_p),
+    ]
+
+
+class _Diag(ctypes.Structure):
+    _fields_ = [
+        ("step", ctypes.c_long),
+        ("t", ctypes.c_double),
+        ("energy", ctypes.c_longdouble),
+        ("enstrophy", ctypes.c_longdouble),
+    ]
+
+
+def _load():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        "libdns.so")
+    if not os.path.exists(path):
+        path = os.environ.get("DNS_LIB", "libdns.so")
+    lib = ctypes.CDLL(path)
+    lib.dns_init.restype = ctypes.c_void_p
+    lib.dns_init.argtypes = [ctypes.POINTER(_Param)]
+    lib.dns_field.restype = _c_double_p
+    lib.dns_field.argtypes = [
+        ctypes.c_void_p, ctypes.c_int,
+        ctypes.POINTER(ctypes.c_long)
+    ]
+    lib.dns_commit.argtypes = [ctypes.c_void_p]
+    lib.dns_ic.restype = ctypes.c_int
+    lib.dns_ic.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_double, ctypes.c_double,
+        ctypes.c_ulong
+    ]
+    lib.dns_step.argtypes = [ctypes.c_void_p, ctypes.c_long]
+    lib.dns_diag.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Diag)]
+    lib.dns_destroy.argtypes = [ctypes.c_void_p]
+    lib.dns_memory.restype = ctypes.c_double
+    lib.dns_memory.argtypes = [
+        ctypes.c_long, ctypes.c_long, ctypes.c_long, ctypes.c_int,
+        ctypes.c_int, ctypes.c_int
+    ]
+    return lib
+
+
+_lib = _load()
+_vars = {"U": 0, "V": 1, "W": 2, "P": 3}
+
+
+def memory(nx, ny, nz, min=False, interleave=False, pressure=False):
+    """Memory of the fields of a run in bytes"""
+    return _lib.dns_memory(nx, ny, nz, min, interleave, pressure)
+
+
+class Dns:
+    """A run on an nx * ny * nz grid, see struct dns_param in dns.h"""
+
+    def __init__(self,
+                 nx,
+                 ny,
+                 nz,
+                 nu,
+                 dt,
+                 L=(2 * math.pi, 2 * math.pi, 2 * math.pi),
+                 min=False,
+                 interleave=False,
+                 pressure=False,
+                 nthreads=0,
+                 verbose=False,
+                 kernels=None,
+                 insitu=None,
+                 scheme=None,
+                 hugepage=0,
+                 ooc=None,
+                 tune=None,
+                 status=None):
+        self.shape = (nx, ny, nz)
+        self._d = None
+        self._closed = False
+        self._views = []
+        p = _Param(nx, ny, nz, L[0], L[1], L[2], nu, dt, min, interleave,
+                   pressure, nthreads, verbose,
+                   None if kernels is None else kernels.encode(),
+                   None if insitu is None else insitu.encode(),
+                   None if scheme is None else scheme.encode(), hugepage,
+                   None if ooc is None else ooc.encode(),
+                   None if tune is None else tune.encode(),
+                   None if status is None else status.encode())
+        self._d = _lib.dns_init(ctypes.byref(p))
+        if not self._d:
+            raise ValueError("dns_init failed")
+
+    def _run(self):
+        if self._closed:
+            raise ValueError("the run is closed")
+        return self._d
+
+    def field(self, name):
+        """Physical field U, V, W or P as a view of the solver's array"""
+        stride = (ctypes.c_long * 3)()
+        u = _lib.dns_field(self._run(), _vars[name], stride)
+        if not u:
+            raise ValueError(f"field {name} is not available")
+        size = sum((n - 1) * s for n, s in zip(self.shape, stride)) + 1
+        buf = (ctypes.c_double * size).from_address(
+            ctypes.addressof(u.contents))
+        buf._dns = self
+        self._views = [v for v in self._views if v() is not None]
+        self._views.append(weakref.ref(buf))
+        return np.ndarray(self.shape,
+                          dtype=np.float64,
+                          buffer=buf,
+                          strides=[8 * s for s in stride])
+
+    def commit(self):
+        """Take the velocity written through field()"""
+        _lib.dns_commit(self._run())
+
+    def ic(self, name, k0=4, u0=1, seed=1):
+        """Built-in initial condition tgv, kp, abc or random"""
+        if _lib.dns_ic(self._run(), name.encode(), k0, u0, seed) != 0:
+            raise ValueError(f"unknown initial condition {name}")
+
+    def step(self, nsteps=1):
+        _lib.dns_step(self._run(), nsteps)
+
+    def diag(self):
+        """Step, time, energy and enstrophy"""
+        d = _Diag()
+        _lib.dns_diag(self._run(), ctypes.byref(d))
+        return d.step, d.t, float(d.energy), float(d.enstrophy)
+
+    def close(self):
+        """End the run; its arrays go with the last view"""
+        self._closed = True
+        if self._d and all(v() is None for v in self._views):
+            _lib.dns_destroy(self._d)
+            self._d = None
+
+    def __del__(self):
+        if self._d:
+            _lib.dns_destroy(self._d)
+            self._d = None
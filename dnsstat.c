@@ -0,0 +1,128 @@
+/* List the runs on this machine from their status records (struct
+   dns_status in dns.h), the files dns.<pid>.<n> in /dev/shm or the
+   directory given. A record is copied between two equal even values of
+   its sequence number. A run whose process is gone, killed before it
+   could remove its record, is shown as "exit" and the record is removed
+   with -c. */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "dns.h"
+#include "util.h"
+
+enum { max_retry = 1000 };
+static const char *names[dns_status_ntime] = {
+    "fft", "copy", "curl", "cross", "project", "update", "rest"};
+
+static int snapshot(const struct dns_status *p, struct dns_status *s) {
+  unsigned long seq;
+  int retry;
+  for (retry = 0; retry < max_retry; retry++) {
+    seq = __atomic_load_n(&p->seq, __ATOMIC_ACQUIRE);
+    if (seq % 2 == 0) {
+      memcpy(s, (const void *)p, sizeof *s);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&p->seq, __ATOMIC_RELAXED) == seq)
+        return s->magic == dns_status_magic ? 0 : -1;
+    }
+    sched_yield();
+  }
+  return -1;
+}
+int main(int argc, char **argv) {
+  (void)argc;
+  const char *dir;
+  char path[FILENAME_MAX], grid[64];
+  struct dirent *e;
+  struct dns_status *p, s;
+  struct stat st;
+  DIR *d;
+  int fd, Clean, alive, header, i;
+  double t;
+
+  dir = "/dev/shm";
+  Clean = 0;
+  while (*++argv != NULL && argv[0][0] == '-') {
+    switch (argv[0][1]) {
+    case 'h':
+      fprintf(stderr, "Usage: dnsstat [-c] [dir]\n"
+                      "\n"
+                      "Options:\n"
+                      "  dir   Directory of the status records "
+                      "(default: /dev/shm)\n"
+                      "  -c    Remove the records of runs which are gone\n"
+                      "  -h    Show this help message\n"
+                      "\n"
+                      "Columns: pid, grid, threads, step, time, time step, "
+                      "energy and its step,\n"
+                      "steps per second, seconds since the last step, "
+                      "resident MiB,\n"
+                      "dirty MiB of the whole machine (not of the run), "
+                      "milliseconds per step of fft,\n"
+                      "copy, curl, cross, project, update and the rest.\n");
+      exit(1);
+    case 'c':
+      Clean = 1;
+      break;
+    default:
+      fprintf(stderr, "dnsstat: error: unknown option '%s'\n", *argv);
+      exit(1);
+    }
+  }
+  if (*argv != NULL)
+    dir = *argv;
+  if ((d = opendir(dir)) == NULL) {
+    fprintf(stderr, "dnsstat: error: fail to open '%s'\n", dir);
+    exit(1);
+  }
+  header = 0;
+  t = wall();
+  while ((e = readdir(d)) != NULL) {
+    if (strncmp(e->d_name, "dns.", 4) != 0)
+      continue;
+    snprintf(path, sizeof path, "%s/%s", dir, e->d_name);
+    if ((fd = open(path, O_RDONLY)) < 0)
+      continue;
+    p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == sizeof *p)
+      p = mmap(NULL, sizeof *p, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      continue;
+    if (snapshot(p, &s) == 0) {
+      alive = kill(s.pid, 0) == 0 || errno == EPERM;
+      if (!header) {
+        printf("%8s %14s %3s %9s %11s %9s %11s %9s %8s %7s %7s %8s", "pid",
+               "grid", "thr", "step", "t", "dt", "energy", "at", "steps/s",
+               "idle", "rss", "sysdirty");
+        for (i = 0; i < dns_status_ntime; i++)
+          printf(" %7s", names[i]);
+        printf("\n");
+        header = 1;
+      }
+      snprintf(grid, sizeof grid, "%ldx%ldx%ld", s.nx, s.ny, s.nz);
+      printf("%8ld %14s %3ld %9ld %11.5e %9.3e %11.5e %9ld %8.3f "
+             "%7.1f %7.0f %8.0f",
+             s.pid, grid, s.nthreads, s.step, s.t, s.dt, s.energy,
+             s.diag_step, s.rate, t - s.update, s.rss / 1048576.0,
+             s.dirty / 1048576.0);
+      for (i = 0; i < dns_status_ntime; i++)
+        printf(" %7.1f", 1e3 * s.time[i]);
+      printf("%s\n", alive ? "" : " exit");
+      if (!alive && Clean)
+        unlink(path);
+    }
+    munmap(p, sizeof *p);
+  }
+  closedir(d);
+}
@@ -0,0 +1,11 @@
+# Seconds per step of the separate (-k scalar) and interleaved (-x)
+# layouts for n = 128, 256, 512
+for l in 7 8 9
+do python tgv.py -l $l -o tgv.$l.raw
+   for o in '-k scalar' -x
+   do printf '%d %s ' $((1 << l)) "$o"
+      ./dns -v $o -t 0.02 -n 0.01 -s 0.01 -i tgv.$l.raw 2>&1 >/dev/null |
+	  awk '/seconds per step/ {print $NF}'
+   done
+   rm tgv.$l.raw
+done
@@ -1,77 +1,211 @@
 #define _GNU_SOURCE
-#include <assert.h>
-#include <complex.h>
 #include <fenv.h>
-#include <fftw3.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#ifdef _OPENMP
-#include <omp.h>
+#include <time.h>
+#ifdef HAVE_HDF5
+#include <hdf5.h>
 #endif
+#include "dns.h"
+#include "util.h"
 
 enum { nvars = 4 };
 static const double pi = 3.141592653589793238;
-static const double a[] = {1 / 6.0, 1 / 3.0, 1 / 3.0, 1 / 6.0};
-static const double b[] = {0.5, 0.5, 1.0};
-static void parallel_loop(void *(*work)(char *), char *jobdata, size_t elsize,
-                          int njobs, void *data) {
-#pragma omp parallel for
-  for (int i = 0; i < njobs; ++i)
-    work(jobdata + elsize * i);
+static const char *names[nvars] = {"U", "V", "W", "P"};
+
+static void xdmf_grid(FILE *file, double t, const struct dns_param *p) {
+  fprintf(file,
+          "      <Time\n"
+          "          Value=\"%+.16e\"/>\n"
+          "      <Topology\n"
+          "          TopologyType=\"3DCoRectMesh\"\n"
+          "          Dimensions=\"%ld %ld %ld\"/>\n"
+          "      <Geometry\n"
+          "          GeometryType=\"ORIGIn_DXDYDZ\">\n"
+          "        <DataItem\n"
+          "            Dimensions=\"3\">\n"
+          "          0\n"
+          "          0\n"
+          "          0\n"
+          "        </DataItem>\n"
+          "        <DataItem\n"
+          "            Dimensions=\"3\">\n"
+          "          %.16e\n"
+          "          %.16e\n"
+          "          %.16e\n"
+          "        </DataItem>\n"
+          "      </Geometry>\n",
+          t, p->nx, p->ny, p->nz, p->Lx / p->nx, p->Ly / p->ny, p->Lz / p->nz);
+}
+/* HDF5 output (-f h5): one file dns.h5 for the run with a group per dump
+   named after the step. The groups hold chunked nx * ny * nz datasets
+   U, V, W, P, optionally shuffled and deflated (-z), and time and step
+   attributes; the run parameters are attributes of the root group.
+   dns.xdmf2 is a temporal collection of all dumps, rewritten after each
+   one so that it is valid while the run goes on. */
+#ifdef HAVE_HDF5
+static void h5_attr(hid_t loc, const char *name, hid_t type,
+                    const void *value) {
+  hid_t space, attr;
+  space = H5Screate(H5S_SCALAR);
+  attr = H5Acreate2(loc, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+  if (attr < 0 || H5Awrite(attr, type, value) < 0) {
+    fprintf(stderr, "dns: error: fail to write attribute '%s'\n", name);
+    exit(1);
+  }
+  H5Aclose(attr);
+  H5Sclose(space);
 }
-static void c2r(fftw_plan fplan, long n3f, fftw_complex *hat, double *real,
-                fftw_complex *work) {
-  long i;
-#pragma omp parallel for
-  for (i = 0; i < n3f; i++)
-    work[i] = hat[i];
-  fftw_execute_dft_c2r(fplan, work, real);
+/* Write a field with the strides of dns_field */
+static void h5_write(hid_t group, const char *name, const struct dns_param *p,
+                     const double *u, const long *stride, int level) {
+  hsize_t dims[3], mdims[3], start[3], step[3], chunk[3];
+  hid_t fspace, mspace, dcpl, dset;
+  int i;
+  dims[0] = mdims[0] = p->nx;
+  dims[1] = mdims[1] = p->ny;
+  dims[2] = p->nz;
+  mdims[2] = stride[1];
+  for (i = 0; i < 3; i++) {
+    start[i] = 0;
+    step[i] = i < 2 ? 1 : stride[2];
+    chunk[i] = dims[i] < 64 ? dims[i] : 64;
+  }
+  fspace = H5Screate_simple(3, dims, NULL);
+  mspace = H5Screate_simple(3, mdims, NULL);
+  H5Sselect_hyperslab(mspace, H5S_SELECT_SET, start, step, dims, NULL);
+  dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(dcpl, 3, chunk);
+  if (level > 0) {
+    H5Pset_shuffle(dcpl);
+    H5Pset_deflate(dcpl, level);
+  }
+  dset = H5Dcreate2(group, name, H5T_NATIVE_DOUBLE, fspace, H5P_DEFAULT, dcpl,
+                    H5P_DEFAULT);
+  if (dset < 0 ||
+      H5Dwrite(dset, H5T_NATIVE_DOUBLE, mspace, fspace, H5P_DEFAULT, u) < 0) {
+    fprintf(stderr, "dns: error: fail to write dataset '%s'\n", name);
+    exit(1);
+  }
+  H5Dclose(dset);
+  H5Pclose(dcpl);
+  H5Sclose(mspace);
+  H5Sclose(fspace);
 }
-static double cabs2(fftw_complex z) {
-  return creal(z) * creal(z) + cimag(z) * cimag(z);
+#endif
+static int smooth(long n) {
+  static const long p[] = {2, 3, 5, 7};
+  size_t i;
+  if (n % 2 != 0)
+    return 0;
+  for (i = 0; i < sizeof p / sizeof *p; i++)
+    while (n % p[i] == 0)
+      n /= p[i];
+  return n == 1;
 }
 int main(int argc, char **argv) {
   (void)argc;
-  fftw_plan fplan, bplan;
   FILE *file;
-  char path[FILENAME_MAX], *input_path, *end;
-  long double energy, Omega;
-  double dx, L, invn3, kmax, nu, dt, T, t;
-  fftw_complex *curlX, *curlY, *curlZ, *dU, *dV, *dW, *P_hat, *U_hat, *U_hat0,
-      *U_hat1, *V_hat, *V_hat0, *V_hat1, *W_hat, *W_hat0, *W_hat1, *dump_hat;
-  int *dealias, rk, Verbose, Dump;
-  long idump, tstep;
+  char path[FILENAME_MAX], *input_path, *ic_name, *end;
+  double nu, dt, T, t, budget, grid[3], box[3], spectrum[3];
+  int Verbose, Dump, Min, Interleave, H5, level;
+  long *dump_step;
+  double *dump_time, *u, *row;
+  char *insitu_path;
+  const char *kernels_name, *scheme;
+  long nmax, hugepage;
+  const char *ooc, *tune, *status;
+  long idump, tstep, rows, n, nx, ny, nz, l, k, stride[3];
   size_t offset;
   size_t ivar;
-  double *CU, *CV, *CW, *kk, *kx, *kz, *U, *U_tmp, *V, *V_tmp, *W, *W_tmp,
-      *dump;
+  struct dns *d;
+  struct dns_param p;
+  struct dns_diag diag;
+  struct timespec start, stop;
+#ifdef HAVE_HDF5
+  hid_t h5, group;
+#endif
   feclearexcept(FE_ALL_EXCEPT);
   feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
 
   input_path = NULL;
+  ic_name = NULL;
+  spectrum[0] = 4;
+  spectrum[1] = 1;
+  spectrum[2] = 1;
   dt = -1;
   T = 0;
   nu = -1;
   Verbose = 0;
   Dump = 0;
+  Min = 0;
+  Interleave = 0;
+  insitu_path = NULL;
+  H5 = 0;
+  level = 0;
+  budget = -1;
+  grid[0] = -1;
+  box[0] = box[1] = box[2] = 2 * pi;
+  kernels_name = NULL;
+  scheme = NULL;
+  hugepage = 0;
+  ooc = NULL;
+  tune = NULL;
+  status = "/dev/shm";
   while (*++argv != NULL && argv[0][0] == '-') {
     switch (argv[0][1]) {
     case 'h':
-      fprintf(stderr, "Usage: dns [-v] [-d] -i <input.raw> -n <viscosity> -t "
-                      "<end time> -s <time step>\n"
+      fprintf(stderr, "Usage: dns [-v] [-d] [-m] -i <input.raw> -n <viscosity> "
+                      "-t <end time> -s <time step>\n"
+                      "       dns [-v] [-d] [-m] -I <flow> -g <nx,ny,nz> "
+                      "-n <viscosity> -t <end time> -s <time step>\n"
+                      "       dns [-d] [-m] [-x] -b <memory budget>\n"
                       "\n"
                       "Options:\n"
                       "  -i <input.raw>    Input file\n"
+                      "  -I <flow>         Built-in initial condition: tgv, "
+                      "kp, abc or random\n"
+                      "  -r <k0,u0,seed>   Spectrum peak, RMS velocity and "
+                      "seed of random\n"
+                      "                    (default: 4,1,1)\n"
                       "  -n <viscosity>    Viscosity\n"
                       "  -t <end time>     End time\n"
                       "  -s <time step>    Time step\n"
+                      "  -g <nx,ny,nz>     Grid size (default: a cube "
+                      "matching the input)\n"
+                      "  -l <Lx,Ly,Lz>     Box lengths (default: 2 pi)\n"
                       "  -v                Verbose output\n"
                       "  -d                Dump snapshots\n"
+                      "  -m                Memory-minimal mode\n"
+                      "  -x                Interleaved vector-field layout\n"
+                      "  -o <insitu.cfg>   In-situ output requests\n"
+                      "  -f <raw|h5>       Dump format (default: raw)\n"
+                      "  -z <level>        Deflate level of h5 dumps "
+                      "(default: 0)\n"
+                      "  -k <kernels>      Spectral kernels: scalar, avx2 or "
+                      "avx512\n"
+                      "                    (default: the widest supported)\n"
+                      "  -a <scheme>       Time stepping: rk4 or ab2cn "
+                      "(default: rk4)\n"
+                      "  -H <2M|1G>        Huge pages of the fields "
+                      "(default: transparent)\n"
+                      "  -O <dir>          Out-of-core: fields in a file in "
+                      "dir\n"
+                      "  -T <file>         Tune threads and pinning, keep the "
+                      "result in file\n"
+                      "  -S <dir|none>     Directory of the status record "
+                      "(default: /dev/shm)\n"
+                      "  -b <bytes>        Print the largest n which fits in "
+                      "the budget\n"
+                      "                    (suffixes K, M, G, T) and exit\n"
                       "  -h                Show this help message\n"
                       "\n"
                       "Example:\n"
-                      "  dns -i tgv.raw -n 0.01 -t 1.0 -s 0.001 -v\n");
+                      "  dns -i tgv.raw -n 0.01 -t 1.0 -s 0.001 -v\n"
+                      "  dns -I random -g 128 -n 0.001 -t 1.0 -s 0.001\n"
+                      "  dns -m -b 64G\n");
 #ifdef _OPENMP
       fprintf(stderr, "\nBuild Info:\n"
                       "  OpenMP is enabled.\n");
@@ -83,6 +217,137 @@ int main(int argc, char **argv) {
     case 'd':
       Dump = 1;
       break;
+    case 'm':
+      Min = 1;
+      break;
+    case 'x':
+      Interleave = 1;
+      break;
+    case 'f':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -f needs an argument\n");
+        exit(1);
+      }
+      if (strcmp(*argv, "raw") == 0)
+        H5 = 0;
+      else if (strcmp(*argv, "h5") == 0)
+        H5 = 1;
+      else {
+        fprintf(stderr, "dns: error: unknown format '%s'\n", *argv);
+        exit(1);
+      }
+      break;
+    case 'z':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -z needs an argument\n");
+        exit(1);
+      }
+      level = strtol(*argv, &end, 10);
+      if (*end != '\0' || level < 0 || level > 9) {
+        fprintf(stderr, "dns: error: '%s' is not a deflate level\n", *argv);
+        exit(1);
+      }
+      break;
+    case 'o':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -o needs an argument\n");
+        exit(1);
+      }
+      insitu_path = *argv;
+      break;
+    case 'k':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -k needs an argument\n");
+        exit(1);
+      }
+      kernels_name = *argv;
+      break;
+    case 'a':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -a needs an argument\n");
+        exit(1);
+      }
+      scheme = *argv;
+      break;
+    case 'H':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -H needs an argument\n");
+        exit(1);
+      }
+      if (strcmp(*argv, "2M") == 0)
+        hugepage = 1L << 21;
+      else if (strcmp(*argv, "1G") == 0)
+        hugepage = 1L << 30;
+      else {
+        fprintf(stderr, "dns: error: '%s' is not a huge page size\n", *argv);
+        exit(1);
+      }
+      break;
+    case 'O':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -O needs an argument\n");
+        exit(1);
+      }
+      ooc = *argv;
+      break;
+    case 'T':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -T needs an argument\n");
+        exit(1);
+      }
+      tune = *argv;
+      break;
+    case 'S':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -S needs an argument\n");
+        exit(1);
+      }
+      status = strcmp(*argv, "none") == 0 ? NULL : *argv;
+      break;
+    case 'b':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -b needs an argument\n");
+        exit(1);
+      }
+      if (!memsize(*argv, &budget)) {
+        fprintf(stderr, "dns: error: '%s' is not a memory size\n", *argv);
+        exit(1);
+      }
+      break;
+    case 'g':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -g needs an argument\n");
+        exit(1);
+      }
+      if (!triple(*argv, grid) || grid[0] < 1 || grid[1] < 1 || grid[2] < 1 ||
+          grid[0] != (long)grid[0] || grid[1] != (long)grid[1] ||
+          grid[2] != (long)grid[2]) {
+        fprintf(stderr, "dns: error: '%s' is not a grid size\n", *argv);
+        exit(1);
+      }
+      break;
+    case 'l':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -l needs an argument\n");
+        exit(1);
+      }
+      if (!triple(*argv, box) || box[0] <= 0 || box[1] <= 0 || box[2] <= 0) {
+        fprintf(stderr, "dns: error: '%s' is not a box size\n", *argv);
+        exit(1);
+      }
+      break;
     case 'i':
       argv++;
       if (*argv == NULL) {
@@ -91,6 +356,26 @@ int main(int argc, char **argv) {
       }
       input_path = *argv;
       break;
+    case 'I':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -I needs an argument\n");
+        exit(1);
+      }
+      ic_name = *argv;
+      break;
+    case 'r':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "dns: error: -r needs an argument\n");
+        exit(1);
+      }
+      if (!triple(*argv, spectrum) || spectrum[0] <= 0 || spectrum[1] < 0 ||
+          spectrum[2] < 0 || spectrum[2] != (unsigned long)spectrum[2]) {
+        fprintf(stderr, "dns: error: '%s' is not a spectrum\n", *argv);
+        exit(1);
+      }
+      break;
     case 'n':
       argv++;
       if (*argv == NULL) {
@@ -132,6 +417,23 @@ int main(int argc, char **argv) {
       exit(1);
     }
   }
+  if (budget != -1) {
+    for (n = 2;
+         dns_memory(n + 2, n + 2, n + 2, Min, Interleave, Dump) <= budget;
+         n += 2)
+      ;
+    if (dns_memory(n, n, n, Min, Interleave, Dump) > budget) {
+      fprintf(stderr, "dns: error: budget is too small\n");
+      exit(1);
+    }
+    if (Verbose)
+      fprintf(stderr, "dns: largest even n: %ld\n", n);
+    for (nmax = n; !smooth(nmax); nmax -= 2)
+      ;
+    printf("%ld %.16e\n", nmax,
+           dns_memory(nmax, nmax, nmax, Min, Interleave, Dump));
+    exit(0);
+  }
   if (T == 0) {
     fprintf(stderr, "dns: error: -t is not set or invalid\n");
     exit(1);
@@ -144,318 +446,240 @@ int main(int argc, char **argv) {
     fprintf(stderr, "dns: error: -s is not set or invalid\n");
     exit(1);
   }
-  if (input_path == NULL) {
-    fprintf(stderr, "dns: error: -i is not set\n");
+  if ((input_path == NULL) == (ic_name == NULL)) {
+    fprintf(stderr, "dns: error: one of -i and -I must be set\n");
     exit(1);
   }
-  if ((file = fopen(input_path, "r")) == NULL) {
-    fprintf(stderr, "dns: error: fail to open '%s'\n", input_path);
+  if (ic_name != NULL && grid[0] == -1) {
+    fprintf(stderr, "dns: error: -I needs -g\n");
     exit(1);
   }
-
-#ifdef _OPENMP
-  fftw_init_threads();
-  fftw_plan_with_nthreads(omp_get_max_threads());
-  if (Verbose)
-    fprintf(stderr, "dns: omp_get_max_threads: %d\n", omp_get_max_threads());
-  fftw_threads_set_callback(parallel_loop, NULL);
-#endif
-  fseek(file, 0, SEEK_END);
-  offset = ftell(file);
-  rewind(file);
-  long n = offset / sizeof(double) / nvars;
-  n = round(powf(n, 1.0 / 3));
-  if (n * n * n * nvars * sizeof(double) != offset) {
-    fprintf(stderr, "dns: error: wrong file '%s'\n", input_path);
+#ifndef HAVE_HDF5
+  if (H5) {
+    fprintf(stderr, "dns: error: -f h5 needs a build with -DHAVE_HDF5\n");
     exit(1);
   }
-  if (Verbose)
-    fprintf(stderr, "dns: n = %ld\n", n);
-  long nf = n / 2 + 1;
-  long n3 = n * n * n;
-  long n3f = n * n * nf;
-  U = fftw_alloc_real(n3);
-  V = fftw_alloc_real(n3);
-  W = fftw_alloc_real(n3);
-  if (fread(U, sizeof(double), n3, file) != (size_t)n3 ||
-      fread(V, sizeof(double), n3, file) != (size_t)n3 ||
-      fread(W, sizeof(double), n3, file) != (size_t)n3 || fclose(file) != 0) {
-    fprintf(stderr, "dns: error: fail to read '%s'\n", input_path);
+#endif
+  file = NULL;
+  offset = 0;
+  if (input_path != NULL) {
+    if ((file = fopen(input_path, "r")) == NULL) {
+      fprintf(stderr, "dns: error: fail to open '%s'\n", input_path);
+      exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    offset = ftell(file);
+    rewind(file);
+  }
+  if (grid[0] == -1) {
+    n = offset / sizeof(double) / nvars;
+    n = round(powf(n, 1.0 / 3));
+    nx = ny = nz = n;
+  } else {
+    nx = grid[0];
+    ny = grid[1];
+    nz = grid[2];
+  }
+  if (file != NULL && nx * ny * nz * nvars * sizeof(double) != offset) {
+    fprintf(stderr, "dns: error: wrong file '%s'\n", input_path);
     exit(1);
   }
-  L = 2 * pi;
-  dx = L / n;
-  invn3 = 1.0 / n3;
-  dump = fftw_alloc_real(n3);
-  U_tmp = fftw_alloc_real(n3);
-  V_tmp = fftw_alloc_real(n3);
-  W_tmp = fftw_alloc_real(n3);
-  CU = fftw_alloc_real(n3);
-  CV = fftw_alloc_real(n3);
-  CW = fftw_alloc_real(n3);
-  kx = malloc(n * sizeof(double));
-  kz = malloc(nf * sizeof(double));
-  kk = malloc(n3f * sizeof(double));
-  dealias = malloc(n3f * sizeof(int));
-  U_hat = fftw_alloc_complex(n3f);
-  V_hat = fftw_alloc_complex(n3f);
-  W_hat = fftw_alloc_complex(n3f);
-  P_hat = fftw_alloc_complex(n3f);
-  U_hat0 = fftw_alloc_complex(n3f);
-  V_hat0 = fftw_alloc_complex(n3f);
-  W_hat0 = fftw_alloc_complex(n3f);
-  U_hat1 = fftw_alloc_complex(n3f);
-  V_hat1 = fftw_alloc_complex(n3f);
-  W_hat1 = fftw_alloc_complex(n3f);
-  dU = fftw_alloc_complex(n3f);
-  dV = fftw_alloc_complex(n3f);
-  dW = fftw_alloc_complex(n3f);
-  curlX = fftw_alloc_complex(n3f);
-  curlY = fftw_alloc_complex(n3f);
-  curlZ = fftw_alloc_complex(n3f);
-  dump_hat = fftw_alloc_complex(n3f);
-  struct {
-    fftw_complex *var;
-    const char *name;
-  } list[nvars] = {{U_hat, "U"}, {V_hat, "V"}, {W_hat, "W"}, {P_hat, "P"}};
-  fplan = fftw_plan_dft_r2c_3d(n, n, n, U, U_hat,
-                               FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  bplan = fftw_plan_dft_c2r_3d(n, n, n, U_hat, U, FFTW_ESTIMATE);
-  for (long i = 0; i < n / 2; i++) {
-    kx[i] = i;
-    kz[i] = i;
+  if (Verbose) {
+    fprintf(stderr, "dns: grid: %ld %ld %ld\n", nx, ny, nz);
+    fprintf(stderr, "dns: memory estimate: %.2f GiB\n",
+            dns_memory(nx, ny, nz, Min, Interleave, Dump) / (1 << 30));
   }
-  kz[n / 2] = n / 2;
-  for (long i = -n / 2; i < 0; i++)
-    kx[i + n] = i;
-  kmax = 2. / 3. * (n / 2 + 1);
-#pragma omp parallel for collapse(3)
-  for (long i = 0; i < n; i++)
-    for (long j = 0; j < n; j++)
-      for (long k = 0; k < nf; k++) {
-        long l = (i * n + j) * nf + k;
-        dealias[l] = (fabs(kx[i]) < kmax) && (fabs(kx[j]) < kmax) &&
-                     (fabs(kz[k]) < kmax);
-      }
-
-#pragma omp parallel for collapse(3)
-  for (long i = 0; i < n; i++)
-    for (long j = 0; j < n; j++)
-      for (long k = 0; k < nf; k++) {
-        long l = (i * n + j) * nf + k;
-        kk[l] = kx[i] * kx[i] + kx[j] * kx[j] + kz[k] * kz[k];
+  p.nx = nx;
+  p.ny = ny;
+  p.nz = nz;
+  p.Lx = box[0];
+  p.Ly = box[1];
+  p.Lz = box[2];
+  p.nu = nu;
+  p.dt = dt;
+  p.min = Min;
+  p.interleave = Interleave;
+  p.pressure = Dump;
+  p.nthreads = 0;
+  p.verbose = Verbose;
+  p.kernels = kernels_name;
+  p.insitu = insitu_path;
+  p.scheme = scheme;
+  p.hugepage = hugepage;
+  p.ooc = ooc;
+  p.tune = tune;
+  p.status = status;
+  if ((d = dns_init(&p)) == NULL)
+    exit(1);
+  rows = nx * ny;
+  row = malloc(nz * sizeof(double));
+  if (file != NULL) {
+    for (ivar = 0; ivar < 3; ivar++) {
+      u = dns_field(d, ivar, stride);
+      for (l = 0; l < rows; l++) {
+        if (fread(row, sizeof(double), nz, file) != (size_t)nz) {
+          fprintf(stderr, "dns: error: fail to read '%s'\n", input_path);
+          exit(1);
+        }
+        for (k = 0; k < nz; k++)
+          u[l * stride[1] + k * stride[2]] = row[k];
       }
+    }
+    if (fclose(file) != 0) {
+      fprintf(stderr, "dns: error: fail to read '%s'\n", input_path);
+      exit(1);
+    }
+    dns_commit(d);
+  } else if (dns_ic(d, ic_name, spectrum[0], spectrum[1], spectrum[2]) != 0)
+    exit(1);
 
-  fftw_execute_dft_r2c(fplan, U, U_hat);
-  fftw_execute_dft_r2c(fplan, V, V_hat);
-  fftw_execute_dft_r2c(fplan, W, W_hat);
-
+#ifdef HAVE_HDF5
+  h5 = group = -1;
+  if (Dump && H5) {
+    if ((h5 = H5Fcreate("dns.h5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)) <
+        0) {
+      fprintf(stderr, "dns: error: fail to create 'dns.h5'\n");
+      exit(1);
+    }
+    h5_attr(h5, "nx", H5T_NATIVE_LONG, &nx);
+    h5_attr(h5, "ny", H5T_NATIVE_LONG, &ny);
+    h5_attr(h5, "nz", H5T_NATIVE_LONG, &nz);
+    h5_attr(h5, "Lx", H5T_NATIVE_DOUBLE, &p.Lx);
+    h5_attr(h5, "Ly", H5T_NATIVE_DOUBLE, &p.Ly);
+    h5_attr(h5, "Lz", H5T_NATIVE_DOUBLE, &p.Lz);
+    h5_attr(h5, "nu", H5T_NATIVE_DOUBLE, &nu);
+    h5_attr(h5, "dt", H5T_NATIVE_DOUBLE, &dt);
+  }
+#endif
+  dump_step = NULL;
+  dump_time = NULL;
   idump = 0;
   t = 0.0;
   tstep = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
   for (;;) {
     if (tstep % 10 == 0) {
-      energy = 0.0;
-      Omega = 0.0;
-#pragma omp parallel for reduction(+ : energy, Omega)
-      for (long k = 0; k < n3f; k++) {
-        energy += cabs2(U_hat[k]) + cabs2(V_hat[k]) + cabs2(W_hat[k]);
-        Omega += kk[k] * (cabs2(U_hat[k]) + cabs2(V_hat[k]) + cabs2(W_hat[k]));
-      }
-      energy *= invn3 * invn3;
-      Omega *= invn3 * invn3;
-      printf("% 10ld % .16e % .16Le % .16Le\n", tstep, t, energy, Omega);
+      dns_diag(d, &diag);
+      printf("% 10ld % .16e % .16Le % .16Le\n", tstep, t, diag.energy,
+             diag.enstrophy);
       fflush(stdout);
       if (Dump) {
-        sprintf(path, "%08ld.raw", tstep);
-        file = fopen(path, "w");
-        for (ivar = 0; ivar < sizeof list / sizeof *list; ivar++) {
-          memcpy(dump_hat, list[ivar].var, n3f * sizeof(fftw_complex));
-          fftw_execute_dft_c2r(bplan, dump_hat, dump);
-#pragma omp parallel for
-          for (long i = 0; i < n3; i++)
-            dump[i] *= invn3;
-          fwrite(dump, n3, sizeof(double), file);
-        }
-        fclose(file);
-        sprintf(path, "a.%08ld.xdmf2", idump);
-        file = fopen(path, "w");
-        fprintf(file,
-                "<Xdmf\n"
-                "    Version=\"2\">\n"
-                "  <Domain>\n"
-                "    <Grid>\n"
-                "      <Time\n"
-                "          Value=\"%+.16e\"/>\n"
-                "      <Topology\n"
-                "          TopologyType=\"3DCoRectMesh\"\n"
-                "          Dimensions=\"%ld %ld %ld\"/>\n"
-                "      <Geometry\n"
-                "          GeometryType=\"ORIGIn_DXDYDZ\">\n"
-                "        <DataItem\n"
-                "            Dimensions=\"3\">\n"
-                "          0\n"
-                "          0\n"
-                "          0\n"
-                "        </DataItem>\n"
-                "        <DataItem\n"
-                "            Dimensions=\"3\">\n"
-                "          %.16e\n"
-                "          %.16e\n"
-                "          %.16e\n"
-                "        </DataItem>\n"
-                "      </Geometry>\n",
-                t, n, n, n, dx, dx, dx);
-        offset = 0;
-        for (ivar = 0; ivar < sizeof list / sizeof *list; ivar++) {
-          fprintf(file,
-                  "      <Attribute\n"
-                  "          name=\"%s\">\n"
-                  "        <DataItem\n"
-                  "            Format=\"Binary\"\n"
-                  "            Seek=\"%ld\"\n"
-                  "            Precision=\"8\"\n"
-                  "            Dimensions=\"%ld %ld %ld\">\n"
-                  "          %08ld.raw\n"
-                  "        </DataItem>\n"
-                  "      </Attribute>\n",
-                  list[ivar].name, offset, n, n, n, idump);
-          offset += n3 * sizeof(double);
+        if (H5) {
+#ifdef HAVE_HDF5
+          sprintf(path, "%08ld", tstep);
+          group = H5Gcreate2(h5, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+          if (group < 0) {
+            fprintf(stderr, "dns: error: fail to create group '%s'\n", path);
+            exit(1);
+          }
+          h5_attr(group, "time", H5T_NATIVE_DOUBLE, &t);
+          h5_attr(group, "step", H5T_NATIVE_LONG, &tstep);
+#endif
+        } else {
+          sprintf(path, "%08ld.raw", tstep);
+          file = fopen(path, "w");
         }
-        fprintf(file, "    </Grid>\n"
-                      "  </Domain>\n"
-                      "</Xdmf>\n");
-        fclose(file);
-        idump++;
-      }
-    }
-    if (t > T)
-      break;
-#pragma omp parallel for
-    for (long k = 0; k < n3f; k++) {
-      U_hat0[k] = U_hat[k];
-      V_hat0[k] = V_hat[k];
-      W_hat0[k] = W_hat[k];
-      U_hat1[k] = U_hat[k];
-      V_hat1[k] = V_hat[k];
-      W_hat1[k] = W_hat[k];
-    }
-    for (rk = 0; rk < 4; rk++) {
-      if (rk > 0) {
-        c2r(bplan, n3f, U_hat, U, curlX); /* dump work space */
-        c2r(bplan, n3f, V_hat, V, curlX);
-        c2r(bplan, n3f, W_hat, W, curlX);
-        for (long k = 0; k < n3; k++) {
-          U[k] *= invn3;
-          V[k] *= invn3;
-          W[k] *= invn3;
+        for (ivar = 0; ivar < nvars; ivar++) {
+          u = dns_field(d, ivar, stride);
+          if (H5) {
+#ifdef HAVE_HDF5
+            h5_write(group, names[ivar], &p, u, stride, level);
+#endif
+          } else
+            for (l = 0; l < rows; l++) {
+              for (k = 0; k < nz; k++)
+                row[k] = u[l * stride[1] + k * stride[2]];
+              fwrite(row, nz, sizeof(double), file);
+            }
         }
-      }
-#pragma omp parallel for collapse(3)
-      for (long i = 0; i < n; i++)
-        for (long j = 0; j < n; j++)
-          for (long k = 0; k < nf; k++) {
-            long l = (i * n + j) * nf + k;
-            curlZ[l] = I * (kx[i] * V_hat[l] - kx[j] * U_hat[l]);
-            curlY[l] = I * (kz[k] * U_hat[l] - kx[i] * W_hat[l]);
-            curlX[l] = I * (kx[j] * W_hat[l] - kz[k] * V_hat[l]);
+        if (H5) {
+#ifdef HAVE_HDF5
+          H5Gclose(group);
+          H5Fflush(h5, H5F_SCOPE_GLOBAL);
+#endif
+          dump_step = realloc(dump_step, (idump + 1) * sizeof *dump_step);
+          dump_time = realloc(dump_time, (idump + 1) * sizeof *dump_time);
+          dump_step[idump] = tstep;
+          dump_time[idump] = t;
+          file = fopen("dns.xdmf2", "w");
+          fprintf(file, "<Xdmf\n"
+                        "    Version=\"2\">\n"
+                        "  <Domain>\n"
+                        "    <Grid\n"
+                        "        GridType=\"Collection\"\n"
+                        "        CollectionType=\"Temporal\">\n");
+          for (long i = 0; i <= idump; i++) {
+            fprintf(file, "    <Grid>\n");
+            xdmf_grid(file, dump_time[i], &p);
+            for (ivar = 0; ivar < nvars; ivar++)
+              fprintf(file,
+                      "      <Attribute\n"
+                      "          name=\"%s\">\n"
+                      "        <DataItem\n"
+                      "            Format=\"HDF\"\n"
+                      "            Precision=\"8\"\n"
+                      "            Dimensions=\"%ld %ld %ld\">\n"
+                      "          dns.h5:/%08ld/%s\n"
+                      "        </DataItem>\n"
+                      "      </Attribute>\n",
+                      names[ivar], nx, ny, nz, dump_step[i],
+                      names[ivar]);
+            fprintf(file, "    </Grid>\n");
           }
-      fftw_execute_dft_c2r(bplan, curlX, CU);
-      fftw_execute_dft_c2r(bplan, curlY, CV);
-      fftw_execute_dft_c2r(bplan, curlZ, CW);
-#pragma omp parallel for
-      for (long k = 0; k < n3; k++) {
-        CU[k] *= invn3;
-        CV[k] *= invn3;
-        CW[k] *= invn3;
-      }
-#pragma omp parallel for
-      for (long k = 0; k < n3; k++) {
-        U_tmp[k] = V[k] * CW[k] - W[k] * CV[k];
-        V_tmp[k] = W[k] * CU[k] - U[k] * CW[k];
-        W_tmp[k] = U[k] * CV[k] - V[k] * CU[k];
-      }
-      fftw_execute_dft_r2c(fplan, U_tmp, dU);
-      fftw_execute_dft_r2c(fplan, V_tmp, dV);
-      fftw_execute_dft_r2c(fplan, W_tmp, dW);
-#pragma omp parallel for
-      for (long k = 0; k < n3f; k++) {
-        dU[k] *= dealias[k] * dt;
-        dV[k] *= dealias[k] * dt;
-        dW[k] *= dealias[k] * dt;
-      }
-#pragma omp parallel for collapse(3)
-      for (long i = 0; i < n; i++)
-        for (long j = 0; j < n; j++)
-          for (long k = 0; k < nf; k++) {
-            long l = (i * n + j) * nf + k; /* TODO */
-            P_hat[l] =
-                kk[l] > 0
-                    ? (dU[l] * kx[i] + dV[l] * kx[j] + dW[l] * kz[k]) / kk[l]
-                    : 0.0;
-            dU[l] -= P_hat[l] * kx[i] + nu * dt * kk[l] * U_hat[l];
-            dV[l] -= P_hat[l] * kx[j] + nu * dt * kk[l] * V_hat[l];
-            dW[l] -= P_hat[l] * kz[k] + nu * dt * kk[l] * W_hat[l];
+          fprintf(file, "    </Grid>\n"
+                        "  </Domain>\n"
+                        "</Xdmf>\n");
+          fclose(file);
+        } else {
+          fclose(file);
+          sprintf(path, "a.%08ld.xdmf2", idump);
+          file = fopen(path, "w");
+          fprintf(file, "<Xdmf\n"
+                        "    Version=\"2\">\n"
+                        "  <Domain>\n"
+                        "    <Grid>\n");
+          xdmf_grid(file, t, &p);
+          offset = 0;
+          for (ivar = 0; ivar < nvars; ivar++) {
+            fprintf(file,
+                    "      <Attribute\n"
+                    "          name=\"%s\">\n"
+                    "        <DataItem\n"
+                    "            Format=\"Binary\"\n"
+                    "            Seek=\"%ld\"\n"
+                    "            Precision=\"8\"\n"
+                    "            Dimensions=\"%ld %ld %ld\">\n"
+                    "          %08ld.raw\n"
+                    "        </DataItem>\n"
+                    "      </Attribute>\n",
+                    names[ivar], offset, nx, ny, nz, tstep);
+            offset += nx * ny * nz * sizeof(double);
           }
-      if (rk < 3) {
-#pragma omp parallel for
-        for (long k = 0; k < n3f; k++) {
-          U_hat[k] = U_hat0[k] + b[rk] * dU[k];
-          V_hat[k] = V_hat0[k] + b[rk] * dV[k];
-          W_hat[k] = W_hat0[k] + b[rk] * dW[k];
+          fprintf(file, "    </Grid>\n"
+                        "  </Domain>\n"
+                        "</Xdmf>\n");
+          fclose(file);
         }
-      }
-#pragma omp parallel for
-      for (long k = 0; k < n3f; ++k) {
-        U_hat1[k] += a[rk] * dU[k];
-        V_hat1[k] += a[rk] * dV[k];
-        W_hat1[k] += a[rk] * dW[k];
+        idump++;
       }
     }
-#pragma omp parallel for
-    for (long k = 0; k < n3f; k++) {
-      U_hat[k] = U_hat1[k];
-      V_hat[k] = V_hat1[k];
-      W_hat[k] = W_hat1[k];
-    }
+    if (t > T)
+      break;
+    dns_step(d, 1);
     t += dt;
     tstep++;
   }
-  fftw_destroy_plan(fplan);
-  fftw_destroy_plan(bplan);
-#ifdef _OPENMP
-  fftw_cleanup_threads();
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  if (Verbose)
+    fprintf(stderr, "dns: seconds per step: %.3e\n",
+            (stop.tv_sec - start.tv_sec + 1e-9 * (stop.tv_nsec - start.tv_nsec)) /
+                tstep);
+  dns_destroy(d);
+#ifdef HAVE_HDF5
+  if (Dump && H5)
+    H5Fclose(h5);
 #endif
-  fftw_free(CU);
-  fftw_free(curlX);
-  fftw_free(curlY);
-  fftw_free(curlZ);
-  fftw_free(CV);
-  fftw_free(CW);
-  fftw_free(dU);
-  fftw_free(dV);
-  fftw_free(dW);
-  fftw_free(P_hat);
-  fftw_free(U);
-  fftw_free(U_hat);
-  fftw_free(U_tmp);
-  fftw_free(V);
-  fftw_free(V_hat);
-  fftw_free(V_hat1);
-  fftw_free(U_hat1);
-  fftw_free(W_hat1);
-  fftw_free(V_hat0);
-  fftw_free(U_hat0);
-  fftw_free(W_hat0);
-  fftw_free(V_tmp);
-  fftw_free(W);
-  fftw_free(W_hat);
-  fftw_free(W_tmp);
-  fftw_free(dump_hat);
-
-  free(dump);
-  free(dealias);
-  free(kx);
-  free(kz);
-  free(kk);
+  free(row);
+  free(dump_step);
+  free(dump_time);
 }
@@ -4,7 +4,18 @@
 #include <math.h>
 #include <stdlib.h>
 
-enum { N = 1 << 5, Nf = N / 2 + 1, tot = N * N * N };
+/* Grid size and box lengths. The spectral arrays are transposed: y is
+   the slowest (distributed) index, then x, then z. */
+enum {
+  NX = 1 << 5,
+  NY = 1 << 5,
+  NZ = 1 << 5,
+  Nf = NZ / 2 + 1,
+  tot = NX * NY * NZ
+};
+#define LX (2 * pi)
+#define LY (2 * pi)
+#define LZ (2 * pi)
 #define MALLOC(var, nelem)                                                     \
   if ((var = fftw_malloc(nelem * sizeof *var)) == NULL) {                      \
     fprintf(stderr, "%s:%d: fftwf_malloc failed\n", __FILE__, __LINE__);       \
@@ -13,7 +24,8 @@ enum { N = 1 << 5, Nf = N / 2 + 1, tot = N * N * N };
 
 int main(int argc, char **argv) {
   double dx;
-  double L;
+  double dy;
+  double dz;
   double s_in;
   double s_out;
   fftw_complex *curlX;
@@ -38,7 +50,6 @@ int main(int argc, char **argv) {
   int i;
   int j;
   int k;
-  int m;
   int rank;
   int rk;
   int tstep;
@@ -49,9 +60,10 @@ int main(int argc, char **argv) {
   double *CV;
   double *CW;
   double *kk;
-  double kmax;
-  double kx[N];
+  double kx[NX];
+  double ky[NY];
   double kz[Nf];
+  double kxmax, kymax, kzmax, m;
   double nu, dt, T;
   double pi = 3.141592653589793238;
   double t;
@@ -70,14 +82,15 @@ int main(int argc, char **argv) {
   nu = 0.000625;
   T = 0.1;
   dt = 0.01;
-  L = 2 * pi;
-  dx = L / N;
+  dx = LX / NX;
+  dy = LY / NY;
+  dz = LZ / NZ;
   MPI_Init(&argc, &argv);
   fftw_mpi_init();
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  n = fftw_mpi_local_size_3d_transposed(N, N, Nf, MPI_COMM_WORLD, &n0, &s0, &n1,
-                                        &s1);
-  assert(n == n1 * N * Nf);
+  n = fftw_mpi_local_size_3d_transposed(NX, NY, Nf, MPI_COMM_WORLD, &n0, &s0,
+                                        &n1, &s1);
+  assert(n == n1 * NX * Nf);
   MALLOC(U, 2 * n);
   MALLOC(V, 2 * n);
   MALLOC(W, 2 * n);
@@ -105,25 +118,24 @@ int main(int argc, char **argv) {
   MALLOC(curlX, n);
   MALLOC(curlY, n);
   MALLOC(curlZ, n);
-  for (i = 0; i < N / 2; i++) {
-    kx[i] = i;
-    kz[i] = i;
-  }
-  kz[N / 2] = N / 2;
-  for (i = -N / 2; i < 0; i++)
-    kx[i + N] = i;
+  for (i = 0; i < NX; i++)
+    kx[i] = (i < (NX + 1) / 2 ? i : i - NX) * (2 * pi / LX);
+  for (i = 0; i < NY; i++)
+    ky[i] = (i < (NY + 1) / 2 ? i : i - NY) * (2 * pi / LY);
+  for (i = 0; i < Nf; i++)
+    kz[i] = i * (2 * pi / LZ);
 
-  rfftn = fftw_mpi_plan_dft_r2c_3d(N, N, N, U, U_hat, MPI_COMM_WORLD,
+  rfftn = fftw_mpi_plan_dft_r2c_3d(NX, NY, NZ, U, U_hat, MPI_COMM_WORLD,
                                    FFTW_MPI_TRANSPOSED_OUT);
-  irfftn = fftw_mpi_plan_dft_c2r_3d(N, N, N, U_hat, U, MPI_COMM_WORLD,
+  irfftn = fftw_mpi_plan_dft_c2r_3d(NX, NY, NZ, U_hat, U, MPI_COMM_WORLD,
                                     FFTW_MPI_TRANSPOSED_IN);
 
   for (i = 0; i < n0; i++)
-    for (j = 0; j < N; j++)
-      for (k = 0; k < N; k++) {
-        z = (i * N + j) * 2 * Nf + k;
-        U[z] = sin(dx * (i + s0)) * cos(dx * j) * cos(dx * k);
-        V[z] = -cos(dx * (i + s0)) * sin(dx * j) * cos(dx * k);
+    for (j = 0; j < NY; j++)
+      for (k = 0; k < NZ; k++) {
+        z = (i * NY + j) * 2 * Nf + k;
+        U[z] = sin(dx * (i + s0)) * cos(dy * j) * cos(dz * k);
+        V[z] = -cos(dx * (i + s0)) * sin(dy * j) * cos(dz * k);
         W[z] = 0.0;
       }
 
@@ -131,20 +143,22 @@ int main(int argc, char **argv) {
   fftw_mpi_execute_dft_r2c(rfftn, V, V_hat);
   fftw_mpi_execute_dft_r2c(rfftn, W, W_hat);
 
-  kmax = 2. / 3. * (N / 2 + 1);
+  kxmax = 2. / 3. * (NX / 2 + 1) * (2 * pi / LX);
+  kymax = 2. / 3. * (NY / 2 + 1) * (2 * pi / LY);
+  kzmax = 2. / 3. * (NZ / 2 + 1) * (2 * pi / LZ);
   for (i = 0; i < n1; i++)
-    for (j = 0; j < N; j++)
+    for (j = 0; j < NX; j++)
       for (k = 0; k < Nf; k++) {
-        z = (i * N + j) * Nf + k;
-        dealias[z] = (fabs(kx[i + s1]) < kmax) * (fabs(kx[j]) < kmax) *
-                     (fabs(kx[k]) < kmax);
+        z = (i * NX + j) * Nf + k;
+        dealias[z] = (fabs(ky[i + s1]) < kymax) * (fabs(kx[j]) < kxmax) *
+                     (fabs(kz[k]) < kzmax);
       }
 
   for (i = 0; i < n1; i++)
-    for (j = 0; j < N; j++)
+    for (j = 0; j < NX; j++)
       for (k = 0; k < Nf; k++) {
-        z = (i * N + j) * Nf + k;
-        m = kx[i + s1] * kx[i + s1] + kx[j] * kx[j] + kx[k] * kx[k];
+        z = (i * NX + j) * Nf + k;
+        m = ky[i + s1] * ky[i + s1] + kx[j] * kx[j] + kz[k] * kz[k];
         kk[z] = m > 0 ? m : 1;
       }
   t = 0.0;
@@ -153,9 +167,9 @@ int main(int argc, char **argv) {
     t += dt;
     tstep++;
     for (i = 0; i < n1; i++)
-      for (j = 0; j < N; j++)
+      for (j = 0; j < NX; j++)
         for (k = 0; k < Nf; k++) {
-          z = (i * N + j) * Nf + k;
+          z = (i * NX + j) * Nf + k;
           U_hat0[z] = U_hat[z];
           V_hat0[z] = V_hat[z];
           W_hat0[z] = W_hat[z];
@@ -175,12 +189,12 @@ int main(int argc, char **argv) {
         }
       }
       for (i = 0; i < n1; i++)
-        for (j = 0; j < N; j++)
+        for (j = 0; j < NX; j++)
           for (k = 0; k < Nf; k++) {
-            z = (i * N + j) * Nf + k;
-            curlZ[z] = I * (kx[i + s1] * V_hat[z] - kx[j] * U_hat[z]);
-            curlY[z] = I * (kz[k] * U_hat[z] - kx[i + s1] * W_hat[z]);
-            curlX[z] = I * (kx[j] * W_hat[z] - kz[k] * V_hat[z]);
+            z = (i * NX + j) * Nf + k;
+            curlZ[z] = I * (kx[j] * V_hat[z] - ky[i + s1] * U_hat[z]);
+            curlY[z] = I * (kz[k] * U_hat[z] - kx[j] * W_hat[z]);
+            curlX[z] = I * (ky[i + s1] * W_hat[z] - kz[k] * V_hat[z]);
           }
       fftw_mpi_execute_dft_c2r(irfftn, curlX, CU);
       fftw_mpi_execute_dft_c2r(irfftn, curlY, CV);
@@ -191,9 +205,9 @@ int main(int argc, char **argv) {
         CW[k] /= tot;
       }
       for (i = 0; i < n0; i++)
-        for (j = 0; j < N; j++)
-          for (k = 0; k < N; k++) {
-            z = (i * N + j) * 2 * Nf + k;
+        for (j = 0; j < NY; j++)
+          for (k = 0; k < NZ; k++) {
+            z = (i * NY + j) * 2 * Nf + k;
             U_tmp[z] = V[z] * CW[z] - W[z] * CV[z];
             V_tmp[z] = W[z] * CU[z] - U[z] * CW[z];
             W_tmp[z] = U[z] * CV[z] - V[z] * CU[z];
@@ -203,47 +217,47 @@ int main(int argc, char **argv) {
       fftw_mpi_execute_dft_r2c(rfftn, W_tmp, dW);
 
       for (i = 0; i < n1; i++)
-        for (j = 0; j < N; j++)
+        for (j = 0; j < NX; j++)
           for (k = 0; k < Nf; k++) {
-            z = (i * N + j) * Nf + k;
+            z = (i * NX + j) * Nf + k;
             dU[z] *= dealias[z] * dt;
             dV[z] *= dealias[z] * dt;
             dW[z] *= dealias[z] * dt;
           }
       for (i = 0; i < n1; i++)
-        for (j = 0; j < N; j++)
+        for (j = 0; j < NX; j++)
           for (k = 0; k < Nf; k++) {
-            z = (i * N + j) * Nf + k;
+            z = (i * NX + j) * Nf + k;
             P_hat[z] =
-                (dU[z] * kx[i + s1] + dV[z] * kx[j] + dW[z] * kz[k]) / kk[z];
-            dU[z] -= P_hat[z] * kx[i + s1] + nu * dt * kk[z] * U_hat[z];
-            dV[z] -= P_hat[z] * kx[j] + nu * dt * kk[z] * V_hat[z];
+                (dU[z] * kx[j] + dV[z] * ky[i + s1] + dW[z] * kz[k]) / kk[z];
+            dU[z] -= P_hat[z] * kx[j] + nu * dt * kk[z] * U_hat[z];
+            dV[z] -= P_hat[z] * ky[i + s1] + nu * dt * kk[z] * V_hat[z];
             dW[z] -= P_hat[z] * kz[k] + nu * dt * kk[z] * W_hat[z];
           }
 
       if (rk < 3) {
         for (i = 0; i < n1; i++)
-          for (j = 0; j < N; j++)
+          for (j = 0; j < NX; j++)
             for (k = 0; k < Nf; k++) {
-              z = (i * N + j) * Nf + k;
+              z = (i * NX + j) * Nf + k;
               U_hat[z] = U_hat0[z] + b[rk] * dU[z];
               V_hat[z] = V_hat0[z] + b[rk] * dV[z];
               W_hat[z] = W_hat0[z] + b[rk] * dW[z];
             }
       }
       for (i = 0; i < n1; i++)
-        for (j = 0; j < N; j++)
+        for (j = 0; j < NX; j++)
           for (k = 0; k < Nf; k++) {
-            z = (i * N + j) * Nf + k;
+            z = (i * NX + j) * Nf + k;
             U_hat1[z] += a[rk] * dU[z];
             V_hat1[z] += a[rk] * dV[z];
             W_hat1[z] += a[rk] * dW[z];
           }
     }
     for (i = 0; i < n1; i++)
-      for (j = 0; j < N; j++)
+      for (j = 0; j < NX; j++)
         for (k = 0; k < Nf; k++) {
-          z = (i * N + j) * Nf + k;
+          z = (i * NX + j) * Nf + k;
           U_hat[z] = U_hat1[z];
           V_hat[z] = V_hat1[z];
           W_hat[z] = W_hat1[z];
@@ -252,12 +266,12 @@ int main(int argc, char **argv) {
     if (tstep % 2 == 0) {
       s_in = 0.0;
       for (i = 0; i < n0; i++)
-        for (j = 0; j < N; j++)
-          for (k = 0; k < N; k++) {
-            z = (i * N + j) * 2 * Nf + k;
+        for (j = 0; j < NY; j++)
+          for (k = 0; k < NZ; k++) {
+            z = (i * NY + j) * 2 * Nf + k;
             s_in += U[z] * U[z] + V[z] * V[z] + W[z] * W[z];
           }
-      s_in *= 0.5 * dx * dx * dx / L / L / L;
+      s_in *= 0.5 * dx * dy * dz / LX / LY / LZ;
       MPI_Reduce(&s_in, &s_out, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
       if (rank == 0)
         fprintf(stderr, "eng: %.16e\n", s_out);
@@ -0,0 +1,291 @@
+/* Change the resolution of a dns input or dump: U, V, W and P on an
+   nx * ny * nz grid (z the fastest index) are resampled to mx * my * mz
+   points by truncating or zero-padding their Fourier modes. The modes
+   kept are those of the smaller grid without its Nyquist mode, so a
+   field resolved on both grids is reproduced to round-off and a coarse
+   run can be restarted on a finer grid, or the other way round.
+
+   The transform is separable and done one axis at a time in physical
+   space. The z and y passes work on one x-plane at a time and write
+   nx * my * mz planes to <output>.tmp; the x pass reads blocks of
+   columns of all planes, sized to the memory budget, and writes them to
+   the output. Only a plane and a block are in memory, so the files can
+   be larger than the RAM. The transforms use the FFTW threads. */
+#define _GNU_SOURCE
+#include <complex.h>
+#include <fftw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "util.h"
+
+enum { nvars = 4 };
+
+/* howmany real transforms of length n resampled to m: along rows of
+   consecutive elements (contiguous) or along columns with a stride of
+   howmany */
+struct pass {
+  long n, m, howmany;
+  int contiguous;
+  double *in, *out;
+  fftw_complex *a, *b;
+  fftw_plan fplan, bplan;
+};
+static void pass_init(struct pass *p, long n, long m, long howmany,
+                      int contiguous) {
+  int nn, mm;
+  long s, nf, mf;
+  nn = n;
+  mm = m;
+  nf = n / 2 + 1;
+  mf = m / 2 + 1;
+  s = contiguous ? 1 : howmany;
+  p->n = n;
+  p->m = m;
+  p->howmany = howmany;
+  p->contiguous = contiguous;
+  p->in = fftw_alloc_real(n * howmany);
+  p->out = fftw_alloc_real(m * howmany);
+  p->a = fftw_alloc_complex(nf * howmany);
+  p->b = fftw_alloc_complex(mf * howmany);
+  p->fplan = fftw_plan_many_dft_r2c(1, &nn, howmany, p->in, NULL, s,
+                                    contiguous ? n : 1, p->a, NULL, s,
+                                    contiguous ? nf : 1, FFTW_ESTIMATE);
+  p->bplan = fftw_plan_many_dft_c2r(1, &mm, howmany, p->b, NULL, s,
+                                    contiguous ? mf : 1, p->out, NULL, s,
+                                    contiguous ? m : 1, FFTW_ESTIMATE);
+}
+static void pass_run(struct pass *p) {
+  long r, k, nf, mf, min;
+  fftw_complex *a, *b;
+  nf = p->n / 2 + 1;
+  mf = p->m / 2 + 1;
+  min = p->n < p->m ? p->n : p->m;
+  fftw_execute(p->fplan);
+  for (r = 0; r < p->howmany; r++) {
+    a = p->contiguous ? p->a + r * nf : p->a + r;
+    b = p->contiguous ? p->b + r * mf : p->b + r;
+    for (k = 0; k < mf; k++)
+      b[p->contiguous ? k : k * p->howmany] =
+          2 * k < min ? a[p->contiguous ? k : k * p->howmany] / p->n : 0;
+  }
+  fftw_execute(p->bplan);
+}
+static void pass_fini(struct pass *p) {
+  fftw_destroy_plan(p->fplan);
+  fftw_destroy_plan(p->bplan);
+  fftw_free(p->in);
+  fftw_free(p->out);
+  fftw_free(p->a);
+  fftw_free(p->b);
+}
+static void xread(double *p, long n, FILE *file, off_t offset,
+                  const char *path) {
+  if (fseeko(file, offset * sizeof(double), SEEK_SET) != 0 ||
+      fread(p, sizeof(double), n, file) != (size_t)n) {
+    fprintf(stderr, "resize: error: fail to read '%s'\n", path);
+    exit(1);
+  }
+}
+static void xwrite(const double *p, long n, FILE *file, off_t offset,
+                   const char *path) {
+  if (fseeko(file, offset * sizeof(double), SEEK_SET) != 0 ||
+      fwrite(p, sizeof(double), n, file) != (size_t)n) {
+    fprintf(stderr, "resize: error: fail to write '%s'\n", path);
+    exit(1);
+  }
+}
+int main(int argc, char **argv) {
+  (void)argc;
+  FILE *input, *output, *tmp;
+  char *input_path, *output_path, tmp_path[FILENAME_MAX];
+  double grid[3], out[3], *x, budget;
+  long nx, ny, nz, mx, my, mz, n, i, c0, b, B, plane;
+  int Verbose, v, nthreads;
+  off_t size;
+  struct pass zp, yp, xp;
+
+  input_path = NULL;
+  output_path = NULL;
+  grid[0] = -1;
+  out[0] = -1;
+  budget = 1 << 30;
+  Verbose = 0;
+  while (*++argv != NULL && argv[0][0] == '-') {
+    switch (argv[0][1]) {
+    case 'h':
+      fprintf(stderr,
+              "Usage: resize [-v] [-g <nx,ny,nz>] -i <input.raw> -G "
+              "<mx,my,mz> -o <output.raw>\n"
+              "\n"
+              "Options:\n"
+              "  -i <input.raw>    Input file or dump\n"
+              "  -g <nx,ny,nz>     Grid size of the input (default: a cube "
+              "matching the input)\n"
+              "  -G <mx,my,mz>     Grid size of the output\n"
+              "  -o <output.raw>   Output file\n"
+              "  -b <bytes>        Memory for a block of columns (suffixes "
+              "K, M, G, T)\n"
+              "                    (default: 1G)\n"
+              "  -v                Verbose output\n"
+              "  -h                Show this help message\n"
+              "\n"
+              "Example:\n"
+              "  resize -i 00001000.raw -G 512 -o tgv.512.raw\n");
+      exit(1);
+    case 'v':
+      Verbose = 1;
+      break;
+    case 'i':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "resize: error: -i needs an argument\n");
+        exit(1);
+      }
+      input_path = *argv;
+      break;
+    case 'o':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "resize: error: -o needs an argument\n");
+        exit(1);
+      }
+      output_path = *argv;
+      break;
+    case 'g':
+    case 'G':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "resize: error: -%c needs an argument\n", argv[-1][1]);
+        exit(1);
+      }
+      x = argv[-1][1] == 'g' ? grid : out;
+      if (!triple(*argv, x) || x[0] < 1 || x[1] < 1 || x[2] < 1 ||
+          x[0] != (long)x[0] || x[1] != (long)x[1] || x[2] != (long)x[2]) {
+        fprintf(stderr, "resize: error: '%s' is not a grid size\n", *argv);
+        exit(1);
+      }
+      break;
+    case 'b':
+      argv++;
+      if (*argv == NULL) {
+        fprintf(stderr, "resize: error: -b needs an argument\n");
+        exit(1);
+      }
+      if (!memsize(*argv, &budget)) {
+        fprintf(stderr, "resize: error: '%s' is not a memory size\n", *argv);
+        exit(1);
+      }
+      break;
+    default:
+      fprintf(stderr, "resize: error: unknown option '%s'\n", *argv);
+      exit(1);
+    }
+  }
+  if (input_path == NULL) {
+    fprintf(stderr, "resize: error: -i is not set\n");
+    exit(1);
+  }
+  if (output_path == NULL) {
+    fprintf(stderr, "resize: error: -o is not set\n");
+    exit(1);
+  }
+  if (out[0] == -1) {
+    fprintf(stderr, "resize: error: -G is not set\n");
+    exit(1);
+  }
+  if ((input = fopen(input_path, "r")) == NULL) {
+    fprintf(stderr, "resize: error: fail to open '%s'\n", input_path);
+    exit(1);
+  }
+  fseeko(input, 0, SEEK_END);
+  size = ftello(input);
+  if (grid[0] == -1) {
+    n = size / sizeof(double) / nvars;
+    n = round(pow(n, 1.0 / 3));
+    nx = ny = nz = n;
+  } else {
+    nx = grid[0];
+    ny = grid[1];
+    nz = grid[2];
+  }
+  if ((off_t)(nx * ny * nz * nvars * sizeof(double)) != size) {
+    fprintf(stderr, "resize: error: wrong file '%s'\n", input_path);
+    exit(1);
+  }
+  mx = out[0];
+  my = out[1];
+  mz = out[2];
+  plane = my * mz;
+  B = budget / (sizeof(double) * (nx + mx) +
+                sizeof(fftw_complex) * (nx / 2 + 1 + mx / 2 + 1));
+  if (B > plane)
+    B = plane;
+  if (B < 1) {
+    fprintf(stderr, "resize: error: budget is too small\n");
+    exit(1);
+  }
+  if ((output = fopen(output_path, "w")) == NULL) {
+    fprintf(stderr, "resize: error: fail to open '%s'\n", output_path);
+    exit(1);
+  }
+  snprintf(tmp_path, sizeof tmp_path, "%s.tmp", output_path);
+  if ((tmp = fopen(tmp_path, "w+")) == NULL) {
+    fprintf(stderr, "resize: error: fail to open '%s'\n", tmp_path);
+    exit(1);
+  }
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+  fftw_init_threads();
+  fftw_plan_with_nthreads(nthreads);
+#else
+  nthreads = 1;
+#endif
+  if (Verbose)
+    fprintf(stderr,
+            "resize: %ld %ld %ld -> %ld %ld %ld, %ld columns per block, "
+            "%d threads\n",
+            nx, ny, nz, mx, my, mz, B, nthreads);
+  pass_init(&zp, nz, mz, ny, 1);
+  pass_init(&yp, ny, my, mz, 0);
+  pass_init(&xp, nx, mx, B, 0);
+  for (v = 0; v < nvars; v++) {
+    for (i = 0; i < nx; i++) {
+      xread(zp.in, ny * nz, input, (v * nx + i) * ny * nz, input_path);
+      pass_run(&zp);
+      memcpy(yp.in, zp.out, ny * mz * sizeof(double));
+      pass_run(&yp);
+      xwrite(yp.out, plane, tmp, i * plane, tmp_path);
+    }
+    for (c0 = 0; c0 < plane; c0 += B) {
+      b = plane - c0 < B ? plane - c0 : B;
+      if (b < B)
+        memset(xp.in, 0, nx * B * sizeof(double));
+      for (i = 0; i < nx; i++)
+        xread(xp.in + i * B, b, tmp, i * plane + c0, tmp_path);
+      pass_run(&xp);
+      for (i = 0; i < mx; i++)
+        xwrite(xp.out + i * B, b, output, (v * mx + i) * plane + c0,
+               output_path);
+    }
+    if (Verbose)
+      fprintf(stderr, "resize: variable %d done\n", v);
+  }
+  pass_fini(&zp);
+  pass_fini(&yp);
+  pass_fini(&xp);
+  fclose(input);
+  fclose(tmp);
+  remove(tmp_path);
+  if (fclose(output) != 0) {
+    fprintf(stderr, "resize: error: fail to write '%s'\n", output_path);
+    exit(1);
+  }
+#ifdef _OPENMP
+  fftw_cleanup_threads();
+#endif
+}
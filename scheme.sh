@@ -0,0 +1,21 @@
+# Largest relative deviation of the energy and of the dissipation rate
+# of -a ab2cn from the Runge-Kutta reference data in 0128/ and the
+# seconds per step of both schemes
+python tgv.py -l 7 -o tgv.7.raw
+for r in 0100 0200 0400 0800 1600 3000
+do nu=`echo $r | awk '{printf "%.16e", 1/$1}'`
+   ./dns -v -a ab2cn -t 10 -n $nu -s 0.0025 -i tgv.7.raw \
+	 2>ab2cn.$r.log >ab2cn.$r
+   printf '%s ' $r
+   paste 0128/$r ab2cn.$r | awk '
+       function abs(x) { return x < 0 ? -x : x }
+       {
+	   e = abs($7 / $3 - 1); if (e > de) de = e
+	   o = abs($8 / $4 - 1); if (o > dO) dO = o
+       }
+       END { printf "%.2e %.2e ", de, dO }'
+   awk '/seconds per step/ {print $NF}' ab2cn.$r.log
+done
+./dns -v -t 0.025 -n 0.01 -s 0.0025 -i tgv.7.raw 2>&1 >/dev/null |
+    awk '/seconds per step/ {print "rk4", $NF}'
+rm tgv.7.raw
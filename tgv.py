@@ -3,7 +3,9 @@ import argparse
 
 parser = argparse.ArgumentParser(
     description="Generate initial conditions for Taylor–Green vortex")
-parser.add_argument("-l", "--level", type=int, required=True)
+group = parser.add_mutually_exclusive_group(required=True)
+group.add_argument("-l", "--level", type=int)
+group.add_argument("-g", "--grid", type=int, nargs=3, metavar=("NX", "NY", "NZ"))
 parser.add_argument("-o", "--output", type=str, required=True)
 args = parser.parse_args()
 
@@ -13,15 +15,19 @@ import numpy as np
 
 L = 2 * math.pi
 nvars = 4
-n = 1 << args.level
-sys.stderr.write(f"tgv.py: {n=}\n")
-dx = L / n
-a = np.memmap(args.output, dtype=float, mode="w+", shape=(nvars, n, n, n))
+if args.grid is None:
+    n = 1 << args.level
+    nx = ny = nz = n
+    sys.stderr.write(f"tgv.py: {n=}\n")
+else:
+    nx, ny, nz = args.grid
+    sys.stderr.write(f"tgv.py: {nx=} {ny=} {nz=}\n")
+a = np.memmap(args.output, dtype=float, mode="w+", shape=(nvars, nx, ny, nz))
 U, V, W, P = a
-i = np.arange(n)
-s = np.sin(dx * i)
-c = np.cos(dx * i)
-np.einsum('i,j,k',  s, c, c, out=U)
-np.einsum('i,j,k', -c, s, c, out=V)
+x = L / nx * np.arange(nx)
+y = L / ny * np.arange(ny)
+z = L / nz * np.arange(nz)
+np.einsum('i,j,k', np.sin(x), np.cos(y), np.cos(z), out=U)
+np.einsum('i,j,k', -np.cos(x), np.sin(y), np.cos(z), out=V)
 P.fill(0)
 W.fill(0)
@@ -0,0 +1,25 @@
+# Diagnostics and in-situ stats with more threads than rows of the pool
+# loops (nx * ny < threads) against a single thread: prints the grids
+# and thread counts whose output differs. The RMS of the stats is summed
+# in double by each thread and the velocities are of order one, so the
+# stats are compared to 1e-12. MALLOC_PERTURB_ fills fresh memory with
+# garbage so that a partial sum which is never written shows.
+printf 'stats 1\n' > threads.cfg
+for g in 4 2,2,32 1,4,64
+do for n in 1 8 32
+   do MALLOC_PERTURB_=165 OMP_NUM_THREADS=$n \
+	 ./dns -S none -I tgv -g $g -n 0.01 -t 0.1 -s 0.01 -o threads.cfg \
+	       2>/dev/null > threads.$n || echo "$g $n failed"
+      mv stats.dat stats.$n
+   done
+   for n in 8 32
+   do cmp -s threads.1 threads.$n && paste stats.1 stats.$n | awk '
+	   function abs(x) { return x < 0 ? -x : x }
+	   {
+	       for (i = 1; i <= NF / 2; i++)
+		   if (abs($i - $(i + NF / 2)) > 1e-12)
+		       exit 1
+	   }' || echo "$g $n differs"
+   done
+done
+rm threads.cfg threads.1 threads.8 threads.32 stats.1 stats.8 stats.32
@@ -0,0 +1,56 @@
+/* Helpers shared by dns, resize, dnsstat and the library: argument
+   parsing and the wall clock. They are static inline so that each
+   program builds from its own sources and this header alone. */
+#include <stdlib.h>
+#include <time.h>
+
+/* Parse "a,b,c" into x; a single number is used for all three */
+static inline int triple(const char *str, double *x) {
+  char *end;
+  int i;
+  for (i = 0; i < 3; i++) {
+    x[i] = strtod(str, &end);
+    if (end == str)
+      return 0;
+    if (i == 0 && *end == '\0') {
+      x[1] = x[2] = x[0];
+      return 1;
+    }
+    if (*end != (i < 2 ? ',' : '\0'))
+      return 0;
+    str = end + 1;
+  }
+  return 1;
+}
+/* Parse a positive number of bytes with an optional suffix K, M, G or T
+   (powers of 1024) into x */
+static inline int memsize(const char *str, double *x) {
+  char *end;
+  double scale;
+  *x = strtod(str, &end);
+  scale = 1;
+  switch (*end) {
+  case 'T':
+    scale *= 1024;
+    /* fall through */
+  case 'G':
+    scale *= 1024;
+    /* fall through */
+  case 'M':
+    scale *= 1024;
+    /* fall through */
+  case 'K':
+    scale *= 1024;
+    end++;
+  }
+  if (end == str || *end != '\0' || *x <= 0)
+    return 0;
+  *x *= scale;
+  return 1;
+}
+/* Seconds since the epoch */
+static inline double wall(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}